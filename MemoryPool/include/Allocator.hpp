@@ -1,6 +1,9 @@
 
 #pragma once
 #include <memory_resource>
+#include <algorithm>
+#include <bit>
+#include <cstring>
 #include <vector>
 #include <unordered_map>
 #include <iostream>
@@ -118,8 +121,7 @@ class SysAllocator
 
 public:
     void *Malloc(size_t bytes, size_t alignment = 32) override{
-        // note: RVO 优化
-        void * ptr = this->do_allocate(bytes, alignment);
+        void * ptr = allocate_block(bytes, alignment);
         MemDetector::Instance().Register(
             get_thread_id(),
             ptr,
@@ -127,16 +129,75 @@ public:
             alignment
         );
         MemDetector::Instance().Print();
-        return this->do_allocate(bytes, alignment);
+        return ptr;
     }
+    /*
+     * @function: 把 ptr 调整为 count 字节, 保留原内容
+     * @note: 新大小不超过块的容量且不小于容量的一半时原地返回, 否则分配新块复制后释放旧块
+     * @note: ptr 为空时等同 Malloc, count 为 0 时等同 Free 并返回 nullptr; alignment 必须与 Malloc 时一致
+     */
     void *Realloc(void * ptr, size_t count, size_t alignment = 32) override{
-        void * _ptr = ::std::malloc(1);
-        return _ptr;
+        if (!ptr) return Malloc(count, alignment);
+        if (!count) {
+            Free(ptr, alignment);
+            return nullptr;
+        }
+        BlockHeader * header = header_of(ptr);
+        if (count <= header->capacity && count > header->capacity / 2) {
+            header->size = count;
+            return ptr;
+        }
+        void * fresh = Malloc(count, alignment);
+        std::memcpy(fresh, ptr, std::min(header->size, count));
+        Free(ptr, alignment);
+        return fresh;
     }
     void Free(void* ptr, size_t alignment = 32) noexcept override{
         std::cout << "SysAllocator:Free" << std::endl;
-        this->do_deallocate(ptr, 1, alignment);
+        if (!ptr) return;
+        const size_t offset = header_bytes(alignment);
+        this->do_deallocate(
+            static_cast<char*>(ptr) - offset,
+            offset + header_of(ptr)->capacity,
+            block_align(alignment)
+        );
+    }
+private:
+    // note: Malloc / Realloc 返回的块前面有一个头部, 记录容量和当前大小, Free 据此给出正确的 bytes
+    // note: memory_resource 的 allocate / deallocate 接口不经过这里, 不带头部
+    struct BlockHeader{
+        size_t capacity;
+        size_t size;
+    };
+
+    static size_t block_align(size_t alignment){
+        return std::max(alignment, alignof(BlockHeader));
     }
+    static size_t header_bytes(size_t alignment){
+        alignment = block_align(alignment);
+        return (sizeof(BlockHeader) + alignment - 1) & ~(alignment - 1);
+    }
+    static BlockHeader * header_of(void * ptr){
+        return reinterpret_cast<BlockHeader*>(static_cast<char*>(ptr) - sizeof(BlockHeader));
+    }
+    // note: 容量按每个 2 的幂区间 4 档向上取整, 浪费不超过 25%, 之后小幅增长可以原地完成
+    static size_t round_capacity(size_t bytes){
+        if (bytes <= 64) return (std::max<size_t>(bytes, 1) + 15) & ~size_t{15};
+        const size_t step = std::bit_floor(bytes - 1) / 4;
+        return (bytes + step - 1) & ~(step - 1);
+    }
+
+    void * allocate_block(size_t bytes, size_t alignment){
+        const size_t offset = header_bytes(alignment);
+        const size_t capacity = round_capacity(bytes);
+        char * base = static_cast<char*>(this->do_allocate(offset + capacity, block_align(alignment)));
+        void * ptr = base + offset;
+        BlockHeader * header = header_of(ptr);
+        header->capacity = capacity;
+        header->size = bytes;
+        return ptr;
+    }
+
 private:
 
     void * do_allocate(std::size_t bytes, std::size_t alignment) override {
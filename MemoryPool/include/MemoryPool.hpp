@@ -1,7 +1,11 @@
 #pragma once
 #include <cstdint>
+#include <cassert>
+#include <algorithm>
 #include <memory_resource>
-#include <cstdint>
+#include <new>
+
+#include "SAllocator.hpp"
 
 #if defined(WIN32) || defined(_WIN32) || defined(_WIN32_) || defined(WIN64) || defined(_WIN64) || defined(_WIN64_)
 #include <windows.h>
@@ -30,8 +34,7 @@
 #define SETSTACKSIZE(size) do {} while(0)
 #endif
 
-constexpr uint32_t stack_size = 8 * 1024 * 1024; // 8MB 栈空间, 多线程情况每个线程8MB
-constexpr uint32_t stack_align = 32;
+constexpr uint32_t stack_size = 8 * 1024 * 1024; // 8MB 临时内存, 每个线程的 StackMemory 各保留一份虚拟地址
 
 enum class MemoryState
 {
@@ -69,29 +72,145 @@ class MemoryDetector
 
 
 /*
- * @function: 栈空间的内存池, 所有的小对象都会使用该内存池进行分配
- */ 
-struct StackMemory : public std::pmr::monotonic_buffer_resource
+ * @function: 线程私有的临时内存: 一段连续的缓冲区上移动指针分配, 按检查点整体回退
+ * @note: 一次请求中的临时对象在检查点之后分配, 请求结束时 Rewind 到检查点, 一次性全部释放
+ * @note: 缓冲区用完后向 upstream 申请(默认是本线程的 Arena), 这些块挂在 overflow 链表上, 同样随 Rewind 释放
+ * @note: 只释放最后一次分配时才真正回收(LIFO), 其余 deallocate 什么也不做, 等待 Rewind
+ * @note: 不是线程安全的, 每个线程通过 Local() 使用自己的实例
+ */
+class StackMemory : public std::pmr::memory_resource
 {
 public:
-    // note: 栈空间用完就没有了
-    explicit StackMemory(std::pmr::memory_resource* upstream = std::pmr::null_memory_resource())
-        : monotonic_buffer_resource(nullptr, 0, upstream){
-            SETSTACKSIZE(stack_size); // note: 设置主线程的最大分配栈空间为 8MB
+    // note: 检查点, 记录当时的栈顶与 overflow 链表头
+    struct Marker
+    {
+        size_t top;
+        void* overflow;
+    };
+
+    /*
+     * @function: RAII 检查点, 析构时回退到构造时的位置
+     * @note: 必须按 LIFO 顺序嵌套, 与函数调用栈一致
+     */
+    class Scope
+    {
+    public:
+        explicit Scope(StackMemory& memory = StackMemory::Local()) noexcept
+            : stack(memory), mark(memory.Mark()) {}
+        ~Scope() { stack.Rewind(mark); }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        StackMemory& Memory() const noexcept { return stack; }
+
+    private:
+        StackMemory& stack;
+        Marker mark;
+    };
+
+    /*
+     * @param: size 缓冲区字节数, 只保留虚拟地址, 物理页在首次写入时才提交
+     * @param: fallback 缓冲区用完后的后备资源, 为空时使用本线程 Arena 的 UnsynchronizedArenaResource
+     */
+    explicit StackMemory(size_t size = stack_size, std::pmr::memory_resource* fallback = nullptr)
+        : upstream(fallback ? fallback : &arena_resource),
+          buf(static_cast<char*>(Stellatus::os_alloc(size))),
+          capacity(buf ? size : 0) {}
+
+    ~StackMemory() override {
+        Rewind(Marker{0, nullptr});
+        if (buf) Stellatus::os_free(buf, capacity);
+    }
+
+    StackMemory(const StackMemory&) = delete;
+    StackMemory& operator=(const StackMemory&) = delete;
+
+    // @function: 当前线程的实例, 线程退出时释放; 从中分配的内存不能比线程活得更久
+    static StackMemory& Local()
+    {
+        thread_local StackMemory stack;
+        return stack;
+    }
+
+    Marker Mark() const noexcept { return Marker{top, overflow}; }
+
+    // @function: 释放 mark 之后的所有分配; mark 必须来自本实例, 且不早于已经回退过的位置
+    void Rewind(Marker mark) noexcept
+    {
+        assert(mark.top <= top && "StackMemory markers must be rewound in LIFO order");
+        top = mark.top;
+        while (overflow != mark.overflow) {
+            Overflow* node = static_cast<Overflow*>(overflow);
+            overflow = node->prev;
+            upstream->deallocate(node, node->bytes, node->align);
         }
+    }
 
-public:
-    void* do_allocate(size_t bytes, size_t alignment) override {
-        void * ptr = monotonic_buffer_resource::do_allocate(bytes, alignment);
+    // @function: 缓冲区中已使用的字节数, 不含 overflow
+    size_t Used() const noexcept { return top; }
+    size_t Capacity() const noexcept { return capacity; }
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override
+    {
+        const uintptr_t base = reinterpret_cast<uintptr_t>(buf);
+        const size_t begin = ((base + top + alignment - 1) & ~uintptr_t(alignment - 1)) - base;
+        if (buf && begin <= capacity && bytes <= capacity - begin) [[likely]] {
+            top = begin + bytes;
+            return buf + begin;
+        }
+        return allocate_overflow(bytes, alignment);
+    }
 
-        return ptr;
+    void do_deallocate(void* ptr, size_t bytes, size_t /*alignment*/) override
+    {
+        char* p = static_cast<char*>(ptr);
+        if (p >= buf && p < buf + capacity) {
+            // note: 只有栈顶的分配能直接回收, 对齐产生的空隙留给 Rewind
+            if (p + bytes == buf + top) top = static_cast<size_t>(p - buf);
+            return;
+        }
+        Overflow* node = static_cast<Overflow*>(overflow);
+        if (node && node->data() == ptr) {
+            overflow = node->prev;
+            upstream->deallocate(node, node->bytes, node->align);
+        }
     }
-    void do_deallocate(void* p, size_t bytes, size_t alignment) override {
 
-        monotonic_buffer_resource::do_deallocate(p, bytes, alignment);
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
     }
+
 private:
-    alignas(stack_align) static char buf [stack_size];
+    // note: overflow 块的头部, 数据紧随其后, 按请求的对齐放置
+    struct Overflow
+    {
+        void* prev;
+        size_t bytes;  // comment: 向 upstream 申请的总字节数
+        size_t align;
+        size_t header; // comment: 头部加填充的字节数
+
+        void* data() noexcept { return reinterpret_cast<char*>(this) + header; }
+    };
+
+    void* allocate_overflow(size_t bytes, size_t alignment)
+    {
+        const size_t align = std::max(alignment, alignof(Overflow));
+        const size_t header = (sizeof(Overflow) + align - 1) & ~(align - 1);
+        void* raw = upstream->allocate(header + bytes, align);
+        Overflow* node = new (raw) Overflow{overflow, header + bytes, align, header};
+        overflow = node;
+        return node->data();
+    }
+
+    Stellatus::UnsynchronizedArenaResource arena_resource;
+    std::pmr::memory_resource* upstream;
+    char* buf;
+    size_t capacity;
+    size_t top = 0;
+    void* overflow = nullptr; // comment: 最近一次 overflow 块, 经 prev 串成链表
 };
 
 class Pool
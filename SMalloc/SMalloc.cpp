@@ -0,0 +1,218 @@
+/*
+ * @function: 用 Stellatus::Arena 替换全局的 malloc 系列函数与全部 operator new / delete
+ * @note: 编译为共享库 libSMalloc.so (cmake -DSALLOCATOR_BUILD_MALLOC=ON), 通过 LD_PRELOAD 注入任意进程
+ * @note: 只支持 Linux + glibc; 导出的符号按 glibc "Replacing malloc" 的要求给出一整套, 不再调用 libc 的分配函数
+ * @note: 与 MemDetector 不同, 这里不需要 REAL_LIBC: 所有内存都来自 os_alloc, 超过 MAX_CACHED_SIZE 的块也单独映射
+ */
+#ifndef SALLOCATOR_MALLOC_OVERRIDE
+#define SALLOCATOR_MALLOC_OVERRIDE
+#endif
+
+#include <cerrno>
+#include <cstddef>
+#include <new>
+
+#include <malloc.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "SAllocator.hpp"
+
+#define SMALLOC_EXPORT __attribute__((visibility("default")))
+
+namespace {
+
+using Stellatus::Arena;
+using Stellatus::ArenaRegistry;
+using Stellatus::ALIGNMENT;
+
+// note: 不能使用 Stellatus::tls_arena: 它的析构在线程退出时先于其他 TLS 析构执行, 之后的 free 会用到已归还的 Arena
+// note: 这里只保存一个裸指针(initial-exec, 不需要动态初始化), 由 pthread key 的析构函数在线程退出时归还
+thread_local Arena* local_arena __attribute__((tls_model("initial-exec"))) = nullptr;
+pthread_key_t arena_key;
+pthread_once_t arena_key_once = PTHREAD_ONCE_INIT;
+
+void release_arena(void* arena) {
+    local_arena = nullptr;
+    ArenaRegistry::instance().release(static_cast<Arena*>(arena));
+}
+
+void create_arena_key() {
+    pthread_key_create(&arena_key, release_arena);
+}
+
+// note: 归还之后仍有 free 时会重新申请一个, pthread 会再调用一轮析构函数
+Arena& arena() {
+    if (Arena* arena = local_arena) [[likely]] return *arena;
+    pthread_once(&arena_key_once, create_arena_key);
+    Arena* arena = ArenaRegistry::instance().acquire();
+    local_arena = arena;
+    pthread_setspecific(arena_key, arena);
+    return *arena;
+}
+
+bool valid_alignment(size_t align) noexcept {
+    return align && !(align & (align - 1));
+}
+
+// @function: C 接口不抛异常, 分配失败时设置 errno 并返回 nullptr
+template <typename Fn>
+void* or_null(Fn&& fn) noexcept {
+    try {
+        return fn();
+    } catch (const std::bad_alloc&) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+}
+
+void* aligned_or_null(size_t size, size_t align) noexcept {
+    return or_null([&] {
+        return align > ALIGNMENT ? arena().allocate_aligned(size, align) : arena().allocate(size);
+    });
+}
+
+// @function: operator new 的语义: 失败时反复调用 new_handler, 没有 new_handler 时抛出 std::bad_alloc
+void* new_impl(size_t size, size_t align) {
+    for (;;) {
+        try {
+            return align > ALIGNMENT ? arena().allocate_aligned(size, align) : arena().allocate(size);
+        } catch (const std::bad_alloc&) {
+            std::new_handler handler = std::get_new_handler();
+            if (!handler) throw;
+            handler();
+        }
+    }
+}
+
+void* new_nothrow(size_t size, size_t align) noexcept {
+    try {
+        return new_impl(size, align);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void delete_impl(void* ptr) noexcept {
+    if (ptr) Arena::free(arena(), ptr, 0);
+}
+
+// note: 库加载时注册一次 fork 处理函数; 不放在 create_arena_key 中, 那里处于首次 malloc 的 pthread_once 之内
+// note: 子进程中调用 fork 的线程保留自己的 local_arena, 其余线程的 Arena 由 after_fork_child 标记为废弃
+__attribute__((constructor)) void register_fork_handlers() {
+    pthread_atfork(Stellatus::prepare_fork, Stellatus::after_fork_parent, Stellatus::after_fork_child);
+}
+
+}
+
+extern "C" {
+
+SMALLOC_EXPORT void* malloc(size_t size) noexcept {
+    return or_null([&] { return arena().allocate(size); });
+}
+
+SMALLOC_EXPORT void free(void* ptr) noexcept {
+    delete_impl(ptr);
+}
+
+SMALLOC_EXPORT void* calloc(size_t num, size_t size) noexcept {
+    size_t bytes = 0;
+    if (__builtin_mul_overflow(num, size, &bytes)) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+    return or_null([&] { return arena().allocate_zeroed(bytes); });
+}
+
+SMALLOC_EXPORT void* realloc(void* ptr, size_t size) noexcept {
+    return or_null([&] { return arena().reallocate(ptr, size); });
+}
+
+SMALLOC_EXPORT void* reallocarray(void* ptr, size_t num, size_t size) noexcept {
+    size_t bytes = 0;
+    if (__builtin_mul_overflow(num, size, &bytes)) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+    return realloc(ptr, bytes);
+}
+
+SMALLOC_EXPORT int posix_memalign(void** out, size_t align, size_t size) noexcept {
+    if (!valid_alignment(align) || align % sizeof(void*)) return EINVAL;
+    void* ptr = aligned_or_null(size, align);
+    if (!ptr) return ENOMEM;
+    *out = ptr;
+    return 0;
+}
+
+SMALLOC_EXPORT void* aligned_alloc(size_t align, size_t size) noexcept {
+    if (!valid_alignment(align)) {
+        errno = EINVAL;
+        return nullptr;
+    }
+    return aligned_or_null(size, align);
+}
+
+SMALLOC_EXPORT void* memalign(size_t align, size_t size) noexcept {
+    return aligned_alloc(align, size);
+}
+
+SMALLOC_EXPORT void* valloc(size_t size) noexcept {
+    return aligned_or_null(size, static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+}
+
+SMALLOC_EXPORT void* pvalloc(size_t size) noexcept {
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return aligned_or_null(Stellatus::align_up(size ? size : 1, page), page);
+}
+
+SMALLOC_EXPORT size_t malloc_usable_size(void* ptr) noexcept {
+    return Arena::usable_size(ptr);
+}
+
+}
+
+SMALLOC_EXPORT void* operator new(size_t size) {
+    return new_impl(size, ALIGNMENT);
+}
+
+SMALLOC_EXPORT void* operator new[](size_t size) {
+    return new_impl(size, ALIGNMENT);
+}
+
+SMALLOC_EXPORT void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return new_nothrow(size, ALIGNMENT);
+}
+
+SMALLOC_EXPORT void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return new_nothrow(size, ALIGNMENT);
+}
+
+SMALLOC_EXPORT void* operator new(size_t size, std::align_val_t align) {
+    return new_impl(size, static_cast<size_t>(align));
+}
+
+SMALLOC_EXPORT void* operator new[](size_t size, std::align_val_t align) {
+    return new_impl(size, static_cast<size_t>(align));
+}
+
+SMALLOC_EXPORT void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return new_nothrow(size, static_cast<size_t>(align));
+}
+
+SMALLOC_EXPORT void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return new_nothrow(size, static_cast<size_t>(align));
+}
+
+SMALLOC_EXPORT void operator delete(void* ptr) noexcept { delete_impl(ptr); }
+SMALLOC_EXPORT void operator delete[](void* ptr) noexcept { delete_impl(ptr); }
+SMALLOC_EXPORT void operator delete(void* ptr, const std::nothrow_t&) noexcept { delete_impl(ptr); }
+SMALLOC_EXPORT void operator delete[](void* ptr, const std::nothrow_t&) noexcept { delete_impl(ptr); }
+SMALLOC_EXPORT void operator delete(void* ptr, size_t) noexcept { delete_impl(ptr); }
+SMALLOC_EXPORT void operator delete[](void* ptr, size_t) noexcept { delete_impl(ptr); }
+SMALLOC_EXPORT void operator delete(void* ptr, std::align_val_t) noexcept { delete_impl(ptr); }
+SMALLOC_EXPORT void operator delete[](void* ptr, std::align_val_t) noexcept { delete_impl(ptr); }
+SMALLOC_EXPORT void operator delete(void* ptr, size_t, std::align_val_t) noexcept { delete_impl(ptr); }
+SMALLOC_EXPORT void operator delete[](void* ptr, size_t, std::align_val_t) noexcept { delete_impl(ptr); }
+SMALLOC_EXPORT void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { delete_impl(ptr); }
+SMALLOC_EXPORT void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { delete_impl(ptr); }
@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "BenchUtil.hpp"
+#include "Backends.hpp"
+#include "Workloads.hpp"
+
+/*
+ * @function: 多线程分配器基准测试
+ * @usage: SAllocatorBench [--threads N] [--ops N] [--json PATH]
+ *                         [--allocators a,b,...] [--workloads a,b,...] [--no-fork]
+ * @note: 线程数从 1 开始按 2 的幂增长到 N(默认为 CPU 核数), N 本身总会被测到
+ * @note: Linux 下每个用例在单独的子进程中运行, 峰值 RSS 与分配器的缓存互不影响
+ */
+
+namespace {
+
+using namespace Bench;
+
+struct Options {
+    unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+    uint64_t ops = 1'000'000;
+    std::string json = "bench_result.json";
+    std::vector<std::string> allocators;
+    std::vector<std::string> workloads;
+    bool fork = true;
+};
+
+using WorkloadFn = RawResult (*)(unsigned, uint64_t);
+
+struct Workload {
+    std::string_view name;
+    WorkloadFn fn;
+};
+
+struct Backend {
+    std::string_view name;
+    std::vector<Workload> workloads;
+};
+
+template <typename B>
+Backend make_backend() {
+    return {B::name, {
+        {"churn", &run_churn<B>},
+        {"prodcons", &run_prodcons<B>},
+        {"larson", &run_larson<B>},
+        {"random", &run_random<B>},
+        {"stl", &run_stl<B>},
+    }};
+}
+
+std::vector<Backend> all_backends() {
+    std::vector<Backend> backends{
+        make_backend<SAllocatorBackend>(),
+        make_backend<JAllocatorBackend>(),
+    };
+#if BENCH_HAS_SYS_ALLOCATOR
+    backends.push_back(make_backend<SysAllocatorBackend>());
+#endif
+    backends.push_back(make_backend<MallocBackend>());
+    return backends;
+}
+
+std::vector<std::string> split(std::string_view list) {
+    std::vector<std::string> items;
+    while (!list.empty()) {
+        const size_t comma = list.find(',');
+        items.emplace_back(list.substr(0, comma));
+        if (comma == std::string_view::npos) break;
+        list.remove_prefix(comma + 1);
+    }
+    return items;
+}
+
+bool selected(const std::vector<std::string>& filter, std::string_view name) {
+    return filter.empty() || std::find(filter.begin(), filter.end(), name) != filter.end();
+}
+
+void usage(const char* prog) {
+    std::fprintf(stderr,
+        "usage: %s [--threads N] [--ops N] [--json PATH]\n"
+        "          [--allocators SAllocator,JAllocator,SysAllocator,malloc]\n"
+        "          [--workloads churn,prodcons,larson,random,stl] [--no-fork]\n", prog);
+}
+
+bool parse(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--threads" && has_value) {
+            opt.max_threads = static_cast<unsigned>(std::max(1L, std::strtol(argv[++i], nullptr, 10)));
+        } else if (arg == "--ops" && has_value) {
+            opt.ops = std::max<uint64_t>(1, std::strtoull(argv[++i], nullptr, 10));
+        } else if (arg == "--json" && has_value) {
+            opt.json = argv[++i];
+        } else if (arg == "--allocators" && has_value) {
+            opt.allocators = split(argv[++i]);
+        } else if (arg == "--workloads" && has_value) {
+            opt.workloads = split(argv[++i]);
+        } else if (arg == "--no-fork") {
+            opt.fork = false;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<unsigned> thread_steps(unsigned max_threads) {
+    std::vector<unsigned> steps;
+    for (unsigned n = 1; n < max_threads; n *= 2) steps.push_back(n);
+    steps.push_back(max_threads);
+    return steps;
+}
+
+RawResult run_case(WorkloadFn fn, unsigned threads, uint64_t ops) {
+    RawResult result = fn(threads, ops);
+    result.peak_rss_kb = peak_rss_kb();
+    return result;
+}
+
+// @function: 在子进程中运行一个用例, 结果经管道传回; 子进程异常退出时返回 false
+bool run_isolated(WorkloadFn fn, unsigned threads, uint64_t ops, RawResult& result) {
+#if defined(__linux__)
+    int fds[2];
+    if (pipe(fds) != 0) return false;
+    const pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        const RawResult raw = run_case(fn, threads, ops);
+        const bool ok = write(fds[1], &raw, sizeof(raw)) == static_cast<ssize_t>(sizeof(raw));
+        _exit(ok ? 0 : 1);
+    }
+    close(fds[1]);
+    const bool ok = read(fds[0], &result, sizeof(result)) == static_cast<ssize_t>(sizeof(result));
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#else
+    result = run_case(fn, threads, ops);
+    return true;
+#endif
+}
+
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parse(argc, argv, opt)) {
+        usage(argv[0]);
+        return 2;
+    }
+#if !BENCH_HAS_SYS_ALLOCATOR
+    if (selected(opt.allocators, "SysAllocator")) {
+        std::fprintf(stderr, "note: <format> is unavailable, skipping SysAllocator\n");
+    }
+#endif
+
+    std::vector<Result> results;
+    print_header();
+    for (const Backend& backend : all_backends()) {
+        if (!selected(opt.allocators, backend.name)) continue;
+        for (const Workload& workload : backend.workloads) {
+            if (!selected(opt.workloads, workload.name)) continue;
+            for (unsigned threads : thread_steps(opt.max_threads)) {
+                RawResult raw{};
+                if (opt.fork) {
+                    if (!run_isolated(workload.fn, threads, opt.ops, raw)) {
+                        std::fprintf(stderr, "%s/%s/%u failed\n",
+                                     backend.name.data(), workload.name.data(), threads);
+                        continue;
+                    }
+                } else {
+                    raw = run_case(workload.fn, threads, opt.ops);
+                }
+                Result result{std::string(backend.name), std::string(workload.name), threads,
+                              raw.ops, raw.seconds, raw.p50_ns, raw.p99_ns, raw.p999_ns, raw.peak_rss_kb};
+                print_result(result);
+                results.push_back(std::move(result));
+            }
+        }
+    }
+
+    if (!write_json(opt.json, results, opt.ops, opt.max_threads)) {
+        std::fprintf(stderr, "failed to write %s\n", opt.json.c_str());
+        return 1;
+    }
+    std::printf("results written to %s\n", opt.json.c_str());
+    return 0;
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory_resource>
+#include <new>
+#include <string_view>
+#include <thread>
+
+#include "SAllocator.hpp"
+#include "JAllocator.hpp"
+
+// note: MemoryPool/include/Allocator.hpp 依赖 <format>, 标准库不支持时跳过 Mem::SysAllocator
+#if __has_include(<format>)
+#include "Allocator.hpp"
+#define BENCH_HAS_SYS_ALLOCATOR 1
+#else
+#define BENCH_HAS_SYS_ALLOCATOR 0
+#endif
+
+/*
+ * @function: 被测分配器的统一接口
+ * @note: allocate/deallocate 用于裸内存的工作负载, stl<T>() 给出可用于标准容器的分配器
+ * @note: SAllocator.hpp 与 JAllocator.hpp 中有同名的 Arena/Chunk, 这里不能 using namespace Stellatus
+ */
+namespace Bench {
+
+template <typename T>
+struct MallocAllocator {
+    using value_type = T;
+
+    MallocAllocator() noexcept = default;
+    template <typename U>
+    MallocAllocator(const MallocAllocator<U>&) noexcept {}
+
+    T* allocate(std::size_t n) {
+        void* ptr = std::malloc(n * sizeof(T));
+        if (!ptr) throw std::bad_alloc{};
+        return static_cast<T*>(ptr);
+    }
+    void deallocate(T* ptr, std::size_t) noexcept { std::free(ptr); }
+};
+
+template <typename T, typename U>
+bool operator==(const MallocAllocator<T>&, const MallocAllocator<U>&) noexcept { return true; }
+template <typename T, typename U>
+bool operator!=(const MallocAllocator<T>&, const MallocAllocator<U>&) noexcept { return false; }
+
+struct MallocBackend {
+    static constexpr std::string_view name = "malloc";
+
+    static void* allocate(std::size_t size) { return std::malloc(size); }
+    static void deallocate(void* ptr, std::size_t) { std::free(ptr); }
+
+    template <typename T>
+    static MallocAllocator<T> stl() { return {}; }
+};
+
+struct SAllocatorBackend {
+    static constexpr std::string_view name = "SAllocator";
+
+    static void* allocate(std::size_t size) {
+        return Stellatus::SAllocator<std::byte>{}.allocate(size);
+    }
+    static void deallocate(void* ptr, std::size_t size) {
+        Stellatus::SAllocator<std::byte>{}.deallocate(static_cast<std::byte*>(ptr), size);
+    }
+
+    template <typename T>
+    static Stellatus::SAllocator<T> stl() { return {}; }
+};
+
+struct JAllocatorBackend {
+    static constexpr std::string_view name = "JAllocator";
+
+    static void* allocate(std::size_t size) {
+        return JAllocator<std::byte>{}.allocate(size);
+    }
+    static void deallocate(void* ptr, std::size_t size) {
+        JAllocator<std::byte>{}.deallocate(static_cast<std::byte*>(ptr), size);
+    }
+
+    template <typename T>
+    static JAllocator<T> stl() { return {}; }
+};
+
+#if BENCH_HAS_SYS_ALLOCATOR
+// note: Mem::SysAllocator::Malloc 每次调用都会打印日志, 这里走它的 memory_resource 接口
+struct SysAllocatorBackend {
+    static constexpr std::string_view name = "SysAllocator";
+
+    static std::pmr::memory_resource& resource() {
+        static Mem::SysAllocator sys;
+        return sys;
+    }
+
+    static void* allocate(std::size_t size) {
+        return resource().allocate(size, alignof(std::max_align_t));
+    }
+    static void deallocate(void* ptr, std::size_t size) {
+        resource().deallocate(ptr, size, alignof(std::max_align_t));
+    }
+
+    template <typename T>
+    static std::pmr::polymorphic_allocator<T> stl() { return {&resource()}; }
+};
+#endif
+
+}
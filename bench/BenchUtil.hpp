@@ -0,0 +1,193 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/resource.h>
+#endif
+
+namespace Bench {
+
+using Clock = std::chrono::steady_clock;
+
+// note: 每 sample_every 次操作记录一次耗时, 避免计时本身拖慢被测的分配器
+constexpr uint64_t sample_every = 64;
+
+inline uint64_t now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now().time_since_epoch()).count());
+}
+
+// note: 可复用的线程屏障, 所有 count 个线程到达后一起放行
+// note: 不使用 std::latch/std::barrier, 部分版本的 libstdc++ 实现会丢失唤醒导致死锁
+class Barrier {
+public:
+    explicit Barrier(size_t count) : count(count) {}
+
+    void arrive_and_wait() {
+        std::unique_lock lock(mtx);
+        const size_t gen = generation;
+        if (++arrived == count) {
+            arrived = 0;
+            ++generation;
+            cv.notify_all();
+            return;
+        }
+        cv.wait(lock, [&] { return gen != generation; });
+    }
+
+private:
+    std::mutex mtx;
+    std::condition_variable cv;
+    size_t count;
+    size_t arrived = 0;
+    size_t generation = 0;
+};
+
+// note: xorshift64*, 每个线程一个, 不与 <random> 的分布对象争抢
+struct Rng {
+    uint64_t state;
+
+    explicit Rng(uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ULL + 1) {}
+
+    uint64_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1DULL;
+    }
+    // @function: [lo, hi] 内的均匀分布
+    size_t range(size_t lo, size_t hi) {
+        return lo + static_cast<size_t>(next() % (hi - lo + 1));
+    }
+};
+
+// note: 线程私有的延迟采样, 工作线程结束后再合并, 采样过程不加锁
+class LatencyRecorder {
+public:
+    explicit LatencyRecorder(uint64_t expect_ops = 0) {
+        samples.reserve(expect_ops / sample_every + 1);
+    }
+
+    // @function: 第 op 次操作是否需要计时
+    bool should_sample(uint64_t op) const noexcept { return op % sample_every == 0; }
+    void record(uint64_t ns) { samples.push_back(ns); }
+
+    void merge(const LatencyRecorder& other) {
+        samples.insert(samples.end(), other.samples.begin(), other.samples.end());
+    }
+
+    // @function: q in [0, 1], 没有样本时返回 0
+    uint64_t percentile(double q) {
+        if (samples.empty()) return 0;
+        const size_t k = std::min(samples.size() - 1,
+                                  static_cast<size_t>(q * static_cast<double>(samples.size())));
+        std::nth_element(samples.begin(), samples.begin() + static_cast<std::ptrdiff_t>(k), samples.end());
+        return samples[k];
+    }
+
+private:
+    std::vector<uint64_t> samples;
+};
+
+// @function: 对 fn 计时并按需记入 recorder, 返回 fn 的结果
+template <typename Fn>
+inline decltype(auto) timed(LatencyRecorder& recorder, uint64_t op, Fn&& fn) {
+    if (!recorder.should_sample(op)) [[likely]] return fn();
+    const uint64_t begin = now_ns();
+    if constexpr (std::is_void_v<decltype(fn())>) {
+        fn();
+        recorder.record(now_ns() - begin);
+    } else {
+        decltype(auto) result = fn();
+        recorder.record(now_ns() - begin);
+        return result;
+    }
+}
+
+// @function: 进程的峰值常驻内存(KB), 不支持的平台返回 0
+inline uint64_t peak_rss_kb() {
+#if defined(__linux__)
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) == 0) return static_cast<uint64_t>(usage.ru_maxrss);
+#endif
+    return 0;
+}
+
+struct Result {
+    std::string allocator;
+    std::string workload;
+    unsigned threads = 0;
+    uint64_t ops = 0;
+    double seconds = 0;
+    uint64_t p50_ns = 0;
+    uint64_t p99_ns = 0;
+    uint64_t p999_ns = 0;
+    uint64_t peak_rss_kb = 0;
+
+    double ops_per_sec() const { return seconds > 0 ? static_cast<double>(ops) / seconds : 0; }
+};
+
+// note: 子进程通过管道回传结果, 只传定长字段, 名字由父进程补上
+struct RawResult {
+    uint64_t ops;
+    double seconds;
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+    uint64_t p999_ns;
+    uint64_t peak_rss_kb;
+};
+
+inline void print_header() {
+    std::printf("%-14s %-12s %7s %14s %10s %10s %10s %12s\n",
+                "allocator", "workload", "threads", "ops/s", "p50(ns)", "p99(ns)", "p999(ns)", "peak RSS(KB)");
+}
+
+inline void print_result(const Result& r) {
+    std::printf("%-14s %-12s %7u %14.0f %10llu %10llu %10llu %12llu\n",
+                r.allocator.c_str(), r.workload.c_str(), r.threads, r.ops_per_sec(),
+                static_cast<unsigned long long>(r.p50_ns),
+                static_cast<unsigned long long>(r.p99_ns),
+                static_cast<unsigned long long>(r.p999_ns),
+                static_cast<unsigned long long>(r.peak_rss_kb));
+    std::fflush(stdout);
+}
+
+// @function: 以 JSON 格式写出全部结果, 便于跨版本对比
+inline bool write_json(const std::string& path, const std::vector<Result>& results,
+                       uint64_t ops_per_thread, unsigned max_threads) {
+    std::ofstream out(path);
+    if (!out) return false;
+    out << "{\n"
+        << "  \"config\": {\"ops_per_thread\": " << ops_per_thread
+        << ", \"max_threads\": " << max_threads
+        << ", \"sample_every\": " << sample_every << "},\n"
+        << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        out << "    {\"allocator\": \"" << r.allocator << "\""
+            << ", \"workload\": \"" << r.workload << "\""
+            << ", \"threads\": " << r.threads
+            << ", \"ops\": " << r.ops
+            << ", \"seconds\": " << r.seconds
+            << ", \"ops_per_sec\": " << static_cast<uint64_t>(r.ops_per_sec())
+            << ", \"p50_ns\": " << r.p50_ns
+            << ", \"p99_ns\": " << r.p99_ns
+            << ", \"p999_ns\": " << r.p999_ns
+            << ", \"peak_rss_kb\": " << r.peak_rss_kb
+            << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return static_cast<bool>(out);
+}
+
+}
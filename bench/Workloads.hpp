@@ -0,0 +1,268 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "BenchUtil.hpp"
+
+/*
+ * @function: 分配器的标准工作负载, 每个函数都以 Backend 为模板参数
+ * @note: threads 为工作线程数, ops 为每个线程的目标操作数(一次分配或一次释放记为一次操作)
+ * @note: 每个工作负载结束前释放自己申请的全部内存
+ */
+namespace Bench {
+
+// note: 裸内存工作负载中对象的首个字长记录自身大小, 释放方无需额外的元数据
+struct Block {
+    void* ptr = nullptr;
+    size_t size = 0;
+};
+
+template <typename Backend>
+inline void* touch_alloc(size_t size) {
+    void* ptr = Backend::allocate(size);
+    std::memcpy(ptr, &size, sizeof(size));
+    return ptr;
+}
+
+inline size_t stored_size(void* ptr) {
+    size_t size = 0;
+    std::memcpy(&size, ptr, sizeof(size));
+    return size;
+}
+
+/*
+ * @function: 启动 threads 个线程执行 body(tid, recorder), 统计墙钟时间并合并延迟样本
+ * @note: 所有线程就绪后同时开始计时, body 返回该线程完成的操作数
+ */
+template <typename Body>
+inline RawResult run_threads(unsigned threads, uint64_t ops, Body&& body) {
+    std::vector<LatencyRecorder> recorders;
+    recorders.reserve(threads);
+    for (unsigned i = 0; i < threads; ++i) recorders.emplace_back(ops);
+    std::vector<uint64_t> done(threads, 0);
+    std::vector<uint64_t> begin(threads, 0);
+    std::vector<uint64_t> end(threads, 0);
+
+    // note: 各线程自己记录起止时间, 主线程可能在屏障之后才被调度, 不能由它计时
+    Barrier start(threads);
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (unsigned tid = 0; tid < threads; ++tid) {
+        workers.emplace_back([&, tid] {
+            start.arrive_and_wait();
+            begin[tid] = now_ns();
+            done[tid] = body(tid, recorders[tid]);
+            end[tid] = now_ns();
+        });
+    }
+    for (std::thread& worker : workers) worker.join();
+
+    LatencyRecorder total;
+    RawResult result{};
+    for (unsigned i = 0; i < threads; ++i) {
+        total.merge(recorders[i]);
+        result.ops += done[i];
+    }
+    const uint64_t first = *std::min_element(begin.begin(), begin.end());
+    const uint64_t last = *std::max_element(end.begin(), end.end());
+    result.seconds = static_cast<double>(last - first) / 1e9;
+    result.p50_ns = total.percentile(0.50);
+    result.p99_ns = total.percentile(0.99);
+    result.p999_ns = total.percentile(0.999);
+    return result;
+}
+
+// @function: 线程内反复申请一批 64 字节的对象再逆序释放, 考察 fast path
+template <typename Backend>
+inline RawResult run_churn(unsigned threads, uint64_t ops) {
+    constexpr size_t batch = 256;
+    constexpr size_t size = 64;
+    return run_threads(threads, ops, [ops](unsigned, LatencyRecorder& rec) {
+        std::vector<void*> live(batch);
+        uint64_t op = 0;
+        while (op < ops) {
+            for (size_t i = 0; i < batch; ++i, ++op) {
+                live[i] = timed(rec, op, [] { return touch_alloc<Backend>(size); });
+            }
+            for (size_t i = batch; i-- > 0; ++op) {
+                timed(rec, op, [&] { Backend::deallocate(live[i], size); });
+            }
+        }
+        return op;
+    });
+}
+
+/*
+ * @function: 生产者申请, 消费者释放, 所有释放都发生在其他线程
+ * @note: 一半线程做生产者, 其余做消费者; threads 为 1 时仍使用一对生产者和消费者
+ * @note: 队列有上限, 生产者过快时等待, 避免测量的是队列堆积而不是分配器
+ */
+template <typename Backend>
+inline RawResult run_prodcons(unsigned threads, uint64_t ops) {
+    constexpr size_t batch = 256;
+    constexpr size_t max_pending = 64;
+    const unsigned producers = threads > 1 ? threads / 2 : 1;
+    const unsigned consumers = threads > 1 ? threads - producers : 1;
+
+    std::mutex mtx;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<std::vector<void*>> queue;
+    unsigned running = producers;
+
+    return run_threads(producers + consumers, ops, [&](unsigned tid, LatencyRecorder& rec) {
+        uint64_t op = 0;
+        if (tid < producers) {
+            Rng rng(tid + 1);
+            while (op < ops) {
+                std::vector<void*> items(batch);
+                for (void*& item : items) {
+                    const size_t size = rng.range(16, 256);
+                    item = timed(rec, op++, [size] { return touch_alloc<Backend>(size); });
+                }
+                std::unique_lock lock(mtx);
+                not_full.wait(lock, [&] { return queue.size() < max_pending; });
+                queue.push_back(std::move(items));
+                not_empty.notify_one();
+            }
+            std::scoped_lock lock(mtx);
+            if (--running == 0) not_empty.notify_all();
+            return op;
+        }
+        for (;;) {
+            std::vector<void*> items;
+            {
+                std::unique_lock lock(mtx);
+                not_empty.wait(lock, [&] { return !queue.empty() || running == 0; });
+                if (queue.empty()) break;
+                items = std::move(queue.front());
+                queue.pop_front();
+                not_full.notify_one();
+            }
+            for (void* item : items) {
+                timed(rec, op++, [item] { Backend::deallocate(item, stored_size(item)); });
+            }
+        }
+        return op;
+    });
+}
+
+/*
+ * @function: larson 测试, 随机替换槽位中的对象, 每个阶段结束时把槽位交给下一个线程
+ * @note: 下一阶段释放的对象都由其他线程申请, 模拟服务器中对象跨线程流转
+ */
+template <typename Backend>
+inline RawResult run_larson(unsigned threads, uint64_t ops) {
+    constexpr size_t slot_num = 1024;
+    constexpr unsigned epochs = 4;
+    std::vector<std::vector<Block>> slots(threads, std::vector<Block>(slot_num));
+    Barrier sync(threads);
+
+    return run_threads(threads, ops, [&](unsigned tid, LatencyRecorder& rec) {
+        Rng rng(tid + 1);
+        uint64_t op = 0;
+        for (Block& block : slots[tid]) {
+            block.size = rng.range(16, 512);
+            block.ptr = touch_alloc<Backend>(block.size);
+        }
+        sync.arrive_and_wait();
+
+        const uint64_t per_epoch = ops / epochs / 2;
+        for (unsigned epoch = 0; epoch < epochs; ++epoch) {
+            std::vector<Block>& mine = slots[(tid + epoch) % threads];
+            for (uint64_t i = 0; i < per_epoch; ++i) {
+                Block& block = mine[rng.range(0, slot_num - 1)];
+                timed(rec, op++, [&] { Backend::deallocate(block.ptr, block.size); });
+                block.size = rng.range(16, 512);
+                block.ptr = timed(rec, op++, [&] { return touch_alloc<Backend>(block.size); });
+            }
+            sync.arrive_and_wait();
+        }
+
+        for (Block& block : slots[(tid + epochs) % threads]) {
+            Backend::deallocate(block.ptr, block.size);
+        }
+        return op;
+    });
+}
+
+/*
+ * @function: 随机大小的对象在固定窗口内随机替换
+ * @note: 80% 在 [16, 256], 15% 在 (256, 4K], 4% 在 (4K, 64K], 1% 在 (64K, 1M]
+ */
+template <typename Backend>
+inline RawResult run_random(unsigned threads, uint64_t ops) {
+    constexpr size_t window = 1024;
+    return run_threads(threads, ops, [ops](unsigned tid, LatencyRecorder& rec) {
+        Rng rng(tid + 1);
+        auto random_size = [&rng] {
+            const size_t bucket = rng.range(0, 99);
+            if (bucket < 80) return rng.range(16, 256);
+            if (bucket < 95) return rng.range(257, 4 << 10);
+            if (bucket < 99) return rng.range((4 << 10) + 1, 64 << 10);
+            return rng.range((64 << 10) + 1, 1 << 20);
+        };
+
+        std::vector<Block> live(window);
+        uint64_t op = 0;
+        while (op < ops) {
+            Block& block = live[rng.range(0, window - 1)];
+            if (block.ptr) {
+                timed(rec, op++, [&] { Backend::deallocate(block.ptr, block.size); });
+            }
+            block.size = random_size();
+            block.ptr = timed(rec, op++, [&] { return touch_alloc<Backend>(block.size); });
+        }
+        for (Block& block : live) {
+            if (block.ptr) Backend::deallocate(block.ptr, block.size);
+        }
+        return op;
+    });
+}
+
+/*
+ * @function: 通过 Backend::stl<T>() 驱动 vector/list/map/string
+ * @note: 每插入一个元素记为一次操作, 容器的扩容和节点分配都经过被测的分配器
+ */
+template <typename Backend>
+inline RawResult run_stl(unsigned threads, uint64_t ops) {
+    constexpr size_t round = 256;
+    return run_threads(threads, ops, [ops](unsigned tid, LatencyRecorder& rec) {
+        using Vec = std::vector<uint64_t, decltype(Backend::template stl<uint64_t>())>;
+        using List = std::list<uint64_t, decltype(Backend::template stl<uint64_t>())>;
+        using Map = std::map<uint64_t, uint64_t, std::less<uint64_t>,
+                             decltype(Backend::template stl<std::pair<const uint64_t, uint64_t>>())>;
+        using String = std::basic_string<char, std::char_traits<char>,
+                                         decltype(Backend::template stl<char>())>;
+
+        Rng rng(tid + 1);
+        uint64_t op = 0;
+        while (op < ops) {
+            Vec vec(Backend::template stl<uint64_t>());
+            List list(Backend::template stl<uint64_t>());
+            Map map(Backend::template stl<std::pair<const uint64_t, uint64_t>>());
+            String str(Backend::template stl<char>());
+            for (size_t i = 0; i < round; ++i) {
+                const uint64_t key = rng.next();
+                timed(rec, op++, [&] { vec.push_back(key); });
+                timed(rec, op++, [&] { list.push_back(key); });
+                timed(rec, op++, [&] { map.emplace(key, i); });
+                timed(rec, op++, [&] { str.append(16, static_cast<char>('a' + i % 26)); });
+            }
+        }
+        return op;
+    });
+}
+
+}
@@ -1,6 +1,8 @@
 #pragma once
 #include <cstdlib>
 #include <type_traits>
+#include "JAllocatorImpl/Arena.hpp"
+#include "JAllocatorImpl/ObjectPool.hpp"
 template <typename Ty>
 class Allocator{
 public:
@@ -22,16 +24,32 @@ public:
     using difference_type = std::ptrdiff_t;
     using propagate_on_container_move_assignment  = std::true_type;
 public:
+    JAllocator() noexcept = default;
+    template <typename U>
+    JAllocator(const JAllocator<U>&) noexcept {}
+
     Ty* allocate(size_t num) override {
-        value_type* mem_ptr = j_malloc(num * sizeof(value_type));
+        value_type* mem_ptr = static_cast<value_type*>(j_malloc(num * sizeof(value_type)));
         return mem_ptr;
     }
     void deallocate(Ty* ptr, size_t size) override {
-
+        j_free(ptr, size * sizeof(value_type));
     }
-private: 
-    void * j_malloc(size_t size){
-
-        return nullptr;
+private:
+    // note: 小对象从当前线程绑定的 Arena 分配, 释放时交还给 slot 所在 Region 所属的 Arena
+    static void * j_malloc(size_t size){
+        return ArenaPool::Instance().Choose()->allocate(size);
     }
-};
\ No newline at end of file
+    static void j_free(void * ptr, size_t size){
+        if (!ptr) return;
+        Arena* arena = size > small_alloc
+                     ? ArenaPool::Instance().Choose()
+                     : Region::from_ptr(ptr)->chunk->arena;
+        arena->deallocate(ptr, size);
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const JAllocator<T>&, const JAllocator<U>&) noexcept { return true; }
+template <typename T, typename U>
+bool operator!=(const JAllocator<T>&, const JAllocator<U>&) noexcept { return false; }
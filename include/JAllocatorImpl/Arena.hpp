@@ -1,19 +1,328 @@
 #pragma once
 #include <vector>
 #include <atomic>
+#include <chrono>
 #include <array>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <thread>
+#include <unordered_map>
 #include "JAllocatorImpl/Region.hpp"
 #include "JAllocatorImpl/Bin.hpp"
 #include "JAllocatorImpl/Chunk.hpp"
 
+// note: Arena 被多个线程共享, bin 各自持锁; avail_runs / spare_chunks 由 mtx 保护
+// note: 大于 small_alloc 的请求不经过 bin, 直接向系统申请, 不小于一个大页时优先使用大页
+
+// note: 空闲超过该时长(毫秒)的 Region 归还物理页, 备用 Chunk 还给系统; 0 表示关闭衰减
+inline std::atomic<int64_t> decay_interval_ms{10'000};
+
+inline void SetDecayInterval(std::chrono::milliseconds interval) noexcept {
+    decay_interval_ms.store(interval.count(), std::memory_order_relaxed);
+}
+
+/*
+ * @function: 记录直接映射的大块实际拿到的页类型, 释放时原样交给 OS_FreeBigPage
+ * @note: 大块不带头部, 返回的就是映射的起始地址, 因此页类型只能放在旁边的表中
+ * @note: 只登记不是 Normal 的映射, 普通页不占表项; 大块的分配与释放本来就有系统调用, 多一次加锁不明显
+ */
+class LargeBlockKinds{
+public:
+    static LargeBlockKinds& Instance(){
+        static LargeBlockKinds table;
+        return table;
+    }
+
+    void Record(void* ptr, OSAllocator::PageKind kind){
+        if (kind == OSAllocator::PageKind::Normal) return;
+        std::scoped_lock lock(mtx);
+        kinds.emplace(ptr, kind);
+    }
+
+    // @function: 取出并删除 ptr 的登记, 没有登记的是 Normal
+    OSAllocator::PageKind Take(void* ptr){
+        std::scoped_lock lock(mtx);
+        auto it = kinds.find(ptr);
+        if (it == kinds.end()) return OSAllocator::PageKind::Normal;
+        const OSAllocator::PageKind kind = it->second;
+        kinds.erase(it);
+        return kind;
+    }
+
+private:
+    std::mutex mtx;
+    std::unordered_map<void*, OSAllocator::PageKind> kinds;
+};
+
 struct Arena{
+    Arena();
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
     void* allocate(const size_t size);
     void deallocate(void* ptr, const size_t size);
+    /*
+     * @function: 一次取出 n 个 size 字节的小对象写入 out, 整批只加一次 bin 锁
+     * @note: 每个 Region 用 alloc_batch 一次取走其中的空闲 slot; size 必须不超过 small_alloc
+     */
+    void allocate_batch(const size_t size, size_t n, void** out);
+    /*
+     * @function: 整体释放 region 中的所有 slot, 只需重置 bitmap, 然后把 Region 还给 Arena
+     * @note: 调用方保证 region 中的对象都不再使用
+     */
+    void reset_region(Region* region);
+
+    // @function: 为 bin_index 号 bin 取一个空闲 Region
+    Region* alloc_region(uint32_t bin_index);
+    // @function: Region 已经整体空闲, 归还给 Arena
+    void release_region(Region* region);
+    /*
+     * @function: 把空闲超过 decay_interval_ms 的内存还给系统, all 为 true 时不看空闲时长
+     * @note: 备用 Chunk 整块释放; avail_runs 中的 Region 只归还头部所在页之外的物理页
+     * @note: 同时解除映射缓存中空闲同样久的映射
+     * @note: alloc_region / release_region 在间隔到期时顺带调用, 不需要后台线程
+     */
+    void purge(bool all = false);
 
     std::atomic<size_t> id;
     std::vector<std::thread::id> thread_ids;          // 占用该 Arena 的线程
     std::array<Chunk*, spare_chunk_num> spare_chunks; // 备用的 Chunk 块
     std::array<Region*, available_region_num> avail_runs;   // 空闲内存块
     std::array<Bin, bin_num> bins;                    // bin 的数量
-};
\ No newline at end of file
+
+    std::mutex mtx;
+    uint32_t spare_num = 0;
+    uint32_t avail_num = 0;
+    std::chrono::steady_clock::time_point last_purge = std::chrono::steady_clock::now();
+
+private:
+    // note: 调用方持有 mtx
+    void purge_locked(bool all);
+    void maybe_purge_locked();
+};
+
+inline Arena::Arena() : id(0) {
+    for (uint32_t i = 0; i < bin_num; ++i) {
+        bins[i].index = i;
+        bins[i].info = bin_infos[i];
+    }
+}
+
+inline void* Arena::allocate(const size_t size) {
+    if (size > small_alloc) [[unlikely]] {
+        OSAllocator::PageKind kind;
+        void* ptr = OSAllocator::OS_AllocBigPage(size, alignof(std::max_align_t), &kind, OSAllocator::CurrentNode);
+        LargeBlockKinds::Instance().Record(ptr, kind);
+        return ptr;
+    }
+    Bin& bin = bins[size_to_bin(size ? size : 1)];
+    std::scoped_lock lock(bin.lock);
+    if (!bin.cur_region || bin.cur_region->full()) {
+        // note: 优先使用地址最低的非满 Region
+        bin.cur_region = bin.regions.empty()
+                       ? alloc_region(bin.index)
+                       : bin.regions.pop();
+    }
+    return bin.cur_region->alloc();
+}
+
+inline void Arena::allocate_batch(const size_t size, size_t n, void** out) {
+    assert(size <= small_alloc && "allocate_batch only serves small objects");
+    Bin& bin = bins[size_to_bin(size ? size : 1)];
+    std::scoped_lock lock(bin.lock);
+    while (n) {
+        if (!bin.cur_region || bin.cur_region->full()) {
+            bin.cur_region = bin.regions.empty()
+                           ? alloc_region(bin.index)
+                           : bin.regions.pop();
+        }
+        const uint32_t want = static_cast<uint32_t>(n < UINT32_MAX ? n : UINT32_MAX);
+        const uint32_t got = bin.cur_region->alloc_batch(out, want);
+        out += got;
+        n -= got;
+    }
+}
+
+inline void Arena::reset_region(Region* region) {
+    Bin& bin = bins[region->bin_index];
+    {
+        std::scoped_lock lock(bin.lock);
+        if (bin.regions.contains(region)) bin.regions.erase(region);
+        if (region == bin.cur_region) bin.cur_region = nullptr;
+        region->reset();
+    }
+    release_region(region);
+}
+
+inline void Arena::deallocate(void* ptr, const size_t size) {
+    if (!ptr) return;
+    if (size > small_alloc) [[unlikely]] {
+        OSAllocator::OS_FreeBigPage(ptr, size, LargeBlockKinds::Instance().Take(ptr));
+        return;
+    }
+    Region* region = Region::from_ptr(ptr);
+    Bin& bin = bins[region->bin_index];
+    std::scoped_lock lock(bin.lock);
+    const bool was_full = region->full();
+    region->free(ptr);
+    if (region == bin.cur_region) return;
+
+    if (region->empty()) {
+        if (bin.regions.contains(region)) bin.regions.erase(region);
+        release_region(region);
+    } else if (std::less<Region*>{}(region, bin.cur_region)) {
+        // note: 更低地址的 Region 有了空位, 切换为当前 Region, 原来的放回堆中
+        if (bin.regions.contains(region)) bin.regions.erase(region);
+        if (!bin.cur_region->full()) bin.regions.push(bin.cur_region);
+        bin.cur_region = region;
+    } else if (was_full) {
+        bin.regions.push(region);
+    }
+}
+
+inline Region* Arena::alloc_region(uint32_t bin_index) {
+    Region* region = nullptr;
+    {
+        std::scoped_lock lock(mtx);
+        if (avail_num == 0) {
+            Chunk* chunk = spare_num ? spare_chunks[--spare_num] : Chunk::Create(this);
+            // note: 倒序压栈, 先取出的是低地址的 Region
+            const auto now = std::chrono::steady_clock::now();
+            for (size_t i = chunk_region_num; i-- > 0;) {
+                Region* r = new (chunk->GetRegion(i)) Region();
+                r->chunk = chunk;
+                r->idle_since = now;
+                avail_runs[avail_num++] = r;
+            }
+        }
+        region = avail_runs[--avail_num];
+        ++region->chunk->used_num;
+        maybe_purge_locked();
+    }
+    region->init(bin_index, bins[bin_index].info.reg_size);
+    return region;
+}
+
+inline void Arena::release_region(Region* region) {
+    std::scoped_lock lock(mtx);
+    Chunk* chunk = region->chunk;
+    --chunk->used_num;
+    if (chunk->used_num == 0) {
+        // note: 整个 Chunk 都空闲了, 从 avail_runs 中摘掉它的 Region, 留作备用或还给系统
+        auto end = std::remove_if(avail_runs.begin(), avail_runs.begin() + avail_num,
+            [chunk](Region* r) { return chunk->Contains(r); });
+        avail_num = static_cast<uint32_t>(end - avail_runs.begin());
+        if (spare_num < spare_chunk_num) {
+            chunk->idle_since = std::chrono::steady_clock::now();
+            spare_chunks[spare_num++] = chunk;
+        } else {
+            Chunk::Destroy(chunk);
+        }
+    } else if (avail_num < available_region_num) {
+        region->idle_since = std::chrono::steady_clock::now();
+        avail_runs[avail_num++] = region;
+    }
+    // note: avail_runs 已满时该 Region 暂不登记, 等所在 Chunk 整体空闲时一并回收
+    maybe_purge_locked();
+}
+
+inline void Arena::purge(bool all) {
+    std::scoped_lock lock(mtx);
+    purge_locked(all);
+}
+
+inline void Arena::maybe_purge_locked() {
+    const int64_t interval = decay_interval_ms.load(std::memory_order_relaxed);
+    if (interval <= 0) return;
+    if (std::chrono::steady_clock::now() - last_purge < std::chrono::milliseconds(interval)) return;
+    purge_locked(false);
+}
+
+inline void Arena::purge_locked(bool all) {
+    const auto now = std::chrono::steady_clock::now();
+    const auto interval = std::chrono::milliseconds(decay_interval_ms.load(std::memory_order_relaxed));
+    last_purge = now;
+    auto expired = [&](std::chrono::steady_clock::time_point since) {
+        return all || now - since >= interval;
+    };
+
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < spare_num; ++i) {
+        if (expired(spare_chunks[i]->idle_since)) {
+            Chunk::Destroy(spare_chunks[i]);
+        } else {
+            spare_chunks[kept++] = spare_chunks[i];
+        }
+    }
+    spare_num = kept;
+
+    // note: Region 头部(含 bitmap)所在的页保留, 重新 init 时只写头部; HugeTLB 映射无法部分归还
+    const std::size_t head = (sizeof(Region) + page - 1) & ~std::size_t{page - 1};
+    for (uint32_t i = 0; i < avail_num; ++i) {
+        Region* region = avail_runs[i];
+        if (region->purged || region->chunk->page_kind == OSAllocator::PageKind::HugeTLB) continue;
+        if (!expired(region->idle_since)) continue;
+        OSAllocator::OS_Purge(reinterpret_cast<char*>(region) + head, region_bytes - head);
+        region->purged = true;
+    }
+    OSAllocator::TrimMappingCache(all ? std::chrono::milliseconds(0) : interval);
+}
+
+/*
+ * @function: 所有线程共享的 Arena 池, 数量为 CPU 核数的 4 倍
+ * @note: 线程第一次分配时按轮询方式绑定一个 Arena, 线程退出时解除绑定
+ */
+class ArenaPool{
+public:
+    static ArenaPool& Instance(){
+        static ArenaPool pool;
+        return pool;
+    }
+
+    Arena* Choose(){
+        thread_local Binding binding(*this);
+        return binding.arena;
+    }
+
+    size_t Size() const noexcept { return arena_num; }
+    Arena& Get(size_t index) { return arenas[index]; }
+
+    // @function: 立即把所有 Arena 中的空闲内存还给系统
+    void Purge(){
+        for (size_t i = 0; i < arena_num; ++i) arenas[i].purge(true);
+    }
+
+private:
+    struct Binding{
+        Arena* arena;
+        explicit Binding(ArenaPool& pool) : arena(pool.Bind()) {}
+        ~Binding(){ ArenaPool::Unbind(arena); }
+    };
+
+    ArenaPool()
+        : arena_num(std::max(1u, std::thread::hardware_concurrency()) * 4),
+          arenas(std::make_unique<Arena[]>(arena_num)) {
+        for (size_t i = 0; i < arena_num; ++i) {
+            arenas[i].id.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    Arena* Bind(){
+        Arena* arena = &arenas[next.fetch_add(1, std::memory_order_relaxed) % arena_num];
+        std::scoped_lock lock(arena->mtx);
+        arena->thread_ids.push_back(std::this_thread::get_id());
+        return arena;
+    }
+
+    static void Unbind(Arena* arena){
+        std::scoped_lock lock(arena->mtx);
+        auto& ids = arena->thread_ids;
+        ids.erase(std::remove(ids.begin(), ids.end(), std::this_thread::get_id()), ids.end());
+    }
+
+    size_t arena_num;
+    std::unique_ptr<Arena[]> arenas;
+    std::atomic<size_t> next{0};
+};
@@ -1,15 +1,45 @@
 #pragma once
-#include <queue>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
 #include "Region.hpp"
 #include "MemoryPoolConfig.hpp"
 
 
+// note: 每个 bin 负责一个 size class, 最大的 size class 正好是 small_alloc
+struct BinInfo{
+    uint32_t reg_size;  // comment: slot 大小
+};
+
+constexpr std::array<BinInfo, bin_num> bin_infos{{
+    {16},   {32},   {48},   {64},
+    {96},   {128},  {192},  {256},
+    {384},  {512},  {768},  {1024},
+    {2048}, {4096}, {8192}, {small_alloc},
+}};
 
+// @function: 把 [1, small_alloc] 的请求大小映射到 bin 下标, 以 16 字节为粒度查表
+constexpr std::size_t bin_lookup_grain = 16;
+constexpr auto bin_lookup = [] {
+    std::array<uint8_t, small_alloc / bin_lookup_grain + 1> table{};
+    uint32_t bin = 0;
+    for (std::size_t i = 0; i < table.size(); ++i) {
+        while (bin_infos[bin].reg_size < i * bin_lookup_grain) ++bin;
+        table[i] = static_cast<uint8_t>(bin);
+    }
+    return table;
+}();
 
-struct BinInfo{};
+constexpr uint32_t size_to_bin(std::size_t size) {
+    return bin_lookup[(size + bin_lookup_grain - 1) / bin_lookup_grain];
+}
 
+// note: Arena 被多个线程共享, 每个 bin 各自持锁, 不同 size class 之间互不阻塞
 struct Bin{
-    Region * cur_region;
-    RegionHeap regions;
-    BinInfo info;
+    Region * cur_region = nullptr;  // comment: 当前正在分配的 Region
+    RegionHeap regions;             // comment: 其余非满的 Region, 按地址排序
+    BinInfo info{};
+    uint32_t index = 0;
+    std::mutex lock;
 };
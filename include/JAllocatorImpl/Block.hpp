@@ -18,40 +18,22 @@ static T* container_of(U* ptr, U T::*member){
     size_t offset = reinterpret_cast<std::ptrdiff_t>(
         &(reinterpret_cast<T const volatile*>(0)->*member)
     );
-    return contain_of<T, U>(ptr, offset);
+    return container_of<T, U>(ptr, offset);
 }
 
 
+/*
+ * @function: 定长内存池中的一个块, 由 BlockGroup 在一段连续映射中按 sizeof(Block) 的步长排列
+ * @note: 空闲时前 8 字节是侵入式链表的 next 指针, 分配出去后整块都是用户内存, 不需要额外的节点
+ * @note: 不足一个指针的块(1, 2, 4 字节)按指针大小占位
+ */
 template <std::size_t Size>
-struct MemNode{
+struct Block{
 public:
     static constexpr std::size_t mem_size = Size;
 public:
-    void * mem;
-    const uint64_t id;
-    bool is_free;
-public:
-    explicit MemNode(uint64_t id) : id(id) {
-        mem = (void*)std::malloc(mem_size);
-        ResetPtr();
-    }
-    MemNode(const MemNode&) = delete;
-    MemNode(MemNode&&) = delete;
-    ~MemNode(){
-        if (mem) [[likely]] {
-            std::free(mem);
-        }
-    }
-
-    bool operator<(const MemNode& other) const {
-        return reinterpret_cast<uintptr_t>(mem) < reinterpret_cast<uintptr_t>(other.mem);
-    }
-    uint64_t GetUId() const noexcept {
-        return id;
-    }
-    const void* GetMemPtr() const {
-        return mem;
-    } 
-
+    union {
+        Block* next;
+        unsigned char mem[Size];
+    };
 };
-
@@ -6,13 +6,8 @@
 #include <mutex>
 #include <cstddef>
 #include <type_traits>
-#include <functional>
-#include <deque>
-#include <set>
-#include <unordered_map>
-#include <unordered_set>
-#include <bitset>
 #include <array>
+#include <algorithm>
 #include <utility>
 #include <chrono>
 #include <thread>
@@ -21,127 +16,218 @@
 #include "MemoryPoolConfig.hpp"
 #include "SysApi.h"
 #include "Block.hpp"
+#include "Region.hpp"
+#include "SizeClass.hpp"
 #include "../static_for.hpp"
-template <std::size_t Size>
-struct Block;
-
-template <
-    std::size_t BlockSize,  
-    template <typename> class Container
->
-struct BlockGroup{};
-
 using namespace std::chrono;
-template <std::size_t BlockSize>
-struct BlockGroup<BlockSize, std::deque>{
+
+/*
+ * @function: MaxNum 个 BlockSize 字节的块组成的定长内存池, 所有块位于一段连续的地址中
+ * @note: 空闲块经 Block::next 串成侵入式链表, Remove / Insert 都是 O(1)
+ * @note: 第一次 Remove 时只保留整组 stride * MaxNum 字节的地址(OS_Reserve), 不占用提交额度
+ * @note: 从未分配过的块由 fresh 按地址顺序切出, 越过已提交的部分时才按 commit_step 提交下一段
+ * @note: 因此最大的几个 class 也只占用实际用到的额度; 额度不足时 Remove 返回 nullptr, 由调用方回退
+ * @note: 块地址减去 base 再除以 stride 就是块的编号, 因此归属判断与 container_of 也是 O(1)
+ * @note: 本身不加锁, 由 BlockGroupProxy 串行化
+ */
+template <std::size_t BlockSize, std::size_t MaxNum>
+struct BlockGroup{
 public:
     using node_type = Block<BlockSize>;
-    using node_type_pointer = Block<BlockSize>*; 
-    using container = std::deque<MemNode<BlockSize>>;
+    using node_type_pointer = Block<BlockSize>*;
     static constexpr std::size_t mem_size = BlockSize;
-    // note: Info 和内部的 mem_ptr 是全时间绑定的, mem_ptr 被销毁则 Info 被销毁
-    struct Info{
-        std::thread::id thread_id;
-        
-        Info(node_type_pointer mem_ptr_) : mem_ptr(mem_ptr_) {
-            create_time = steady_clock::now();
-        }
-
-        ~Info(){
-            enter_duration = OverTimekeeping(create_time);
-            mem_ptr = nullptr;
-        }
-        void mark_enter(){
-            enter_time = steady_clock::now();
-        }
-        void mark_quit(){
-            enter_duration = OverTimekeeping(enter_time);
-        }
-        milliseconds GetEnterTime() const {
-            return enter_duration;
-        }
-        milliseconds GetLifeTime() const {
-            return life_duration;
-        }
-    private:
-        milliseconds OverTimekeeping(steady_clock::time_point which_time){
-            auto quit_time = steady_clock::now();
-            enter_duration += duration_cast<milliseconds>(
-                quit_time - which_time
-            );
-        } 
-    private:
-        node_type_pointer mem_ptr;
-
-        steady_clock::time_point enter_time;
-        steady_clock::time_point create_time;
-
-        milliseconds enter_duration;
-        milliseconds life_duration;
-    };
+    static constexpr std::size_t max_num = MaxNum;
+    static constexpr std::size_t stride = sizeof(node_type);
+    static constexpr std::size_t bytes = stride * MaxNum;
+    static constexpr std::size_t commit_step = std::size_t{64} << 10; // 每次至少提交 64KB, 是常见页大小的整数倍
 private:
-    container con;
-    std::set<Info> free_nodes;
-    std::set<Info> used_nodes;
+    node_type_pointer base = nullptr;
+    node_type_pointer free_list = nullptr;
+    std::size_t fresh = 0;      // comment: [0, fresh) 的块至少被分配过一次
+    std::size_t used = 0;
+    std::size_t committed = 0;  // comment: [base, base + committed) 已可读写
 public:
-    explicit BlockGroup(){}
+    BlockGroup() = default;
 
     BlockGroup(const BlockGroup&) = delete;
     BlockGroup(BlockGroup&&) = delete;
     ~BlockGroup() {
-        con.clear();
-        free_nodes.clear();
-        used_nodes.clear();
+        if (base) OSAllocator::OS_Release(base, bytes);
     }
 
-    // @function 往内存链表中, 插入内存块
-    // @return 返回信息
-    Block<BlockSize>::Info Insert(node_type_pointer block){
-        return {};
+    // @function: 取出一个空闲块, 所有块都已分配或映射失败时返回 nullptr
+    node_type_pointer Remove(){
+        if (node_type_pointer block = free_list) [[likely]] {
+            free_list = block->next;
+            ++used;
+            return block;
+        }
+        if (fresh == MaxNum) return nullptr;
+        if (!base) {
+            try {
+                base = static_cast<node_type_pointer>(OSAllocator::OS_Reserve(bytes, alignof(node_type), OSAllocator::CurrentNode));
+            } catch (const std::bad_alloc&) {
+                return nullptr;
+            }
+        }
+        const std::size_t end = (fresh + 1) * stride;
+        if (end > committed) {
+            const std::size_t page_size = OSAllocator::GetPageSize();
+            const std::size_t step = std::max(commit_step, page_size);
+            const std::size_t limit = (bytes + page_size - 1) & ~(page_size - 1);
+            const std::size_t want = std::min((end + step - 1) & ~(step - 1), limit);
+            if (!OSAllocator::OS_Commit(reinterpret_cast<char*>(base) + committed, want - committed)) return nullptr;
+            committed = want;
+        }
+        ++used;
+        return base + fresh++;
     }
-    Block<BlockSize>::Info Remove(node_type_pointer block){
-        return {};
+
+    // @function: 把 block 放回空闲链表, block 必须来自本组
+    void Insert(node_type_pointer block) noexcept {
+        block->next = free_list;
+        free_list = block;
+        --used;
     }
-private:
-    static Info& CreateMemInfo(std::thread::id id){
-        
+
+    // @function: ptr 是否为本组中某个块的起始地址
+    bool Contains(const void* ptr) const noexcept {
+        const uintptr_t offset = reinterpret_cast<uintptr_t>(ptr) - reinterpret_cast<uintptr_t>(base);
+        return base && offset < bytes && offset % stride == 0;
     }
 
+    std::size_t Used() const noexcept { return used; }
 };
+
 struct IBlockGroupProxy{
     virtual ~IBlockGroupProxy() = default;
+    // @function: 取出一个块, 池已耗尽时返回 nullptr, 由调用方回退到其他分配方式
+    virtual void* Allocate() = 0;
+    // @function: 归还 ptr, ptr 不属于本池时什么都不做并返回 false
+    virtual bool Deallocate(void* ptr) = 0;
+    virtual bool Contains(const void* ptr) const = 0;
+    virtual std::size_t GetBlockSize() const noexcept = 0;
 };
 
 template <std::size_t BlockSize, std::size_t MaxSize>
 struct BlockGroupProxy : IBlockGroupProxy {
     static constexpr std::size_t mem_size = BlockSize;
     static constexpr std::size_t max_size = MaxSize;
-    std::unique_ptr<BlockGroup<BlockSize, std::deque>> group;
+    using block_type = Block<BlockSize>;
+    using block_ptr = Block<BlockSize>*;
 
-    BlockGroupProxy()
-        : group(MakeBlockGroup<BlockSize, MaxSize>()) {}
+    BlockGroup<BlockSize, MaxSize> group;
+    mutable std::mutex lock;
 
-    void Insert(Block<mem_size>* block){}
+    void* Allocate() override {
+        std::scoped_lock guard(lock);
+        block_ptr block = group.Remove();
+        return block ? block->mem : nullptr;
+    }
 
-    void Remove(void* ptr){
-        using block_type = Block<BlockSize>;
-        using block_ptr = Block<BlockSize>* ;
+    void Insert(block_ptr block){
+        std::scoped_lock guard(lock);
+        group.Insert(block);
+    }
+
+    bool Deallocate(void* ptr) override {
         block_ptr mem_ptr = container_of<block_type>(ptr, offsetof(block_type, mem));
-        group.Remove(mem_ptr);
+        std::scoped_lock guard(lock);
+        if (!group.Contains(mem_ptr)) return false;
+        group.Insert(mem_ptr);
+        return true;
     }
+
+    bool Contains(const void* ptr) const override {
+        std::scoped_lock guard(lock);
+        return group.Contains(ptr);
+    }
+
+    std::size_t GetBlockSize() const noexcept override { return mem_size; }
 };
 
+/*
+ * @function: MemPoolConfig 中的每个 MemConfig<Size, Num> 都对应一个 BlockGroupProxy<Size, Num>
+ * @note: 代理在编译期按 SizeClass 的下标用 static_for 展开生成, 运行时经 SizeClass::Index 查表选择
+ * @usage: void* ptr = BlockPool::Instance().Allocate(size); BlockPool::Instance().Deallocate(ptr, size);
+ */
+class BlockPool{
+public:
+    static BlockPool& Instance(){
+        static BlockPool pool;
+        return pool;
+    }
+
+    BlockPool(const BlockPool&) = delete;
+    BlockPool& operator=(const BlockPool&) = delete;
+
+    // @function: 从能容纳 size 的最小 class 中取一个块, 超过最大 class 或该 class 已耗尽时返回 nullptr
+    void* Allocate(std::size_t size){
+        const uint32_t index = SizeClass::Index(size);
+        if (index == SizeClass::npos) return nullptr;
+        return proxies[index]->Allocate();
+    }
+
+    // @function: size 必须与 Allocate 时一致, ptr 不属于该 class 时返回 false
+    bool Deallocate(void* ptr, std::size_t size){
+        if (!ptr) return true;
+        const uint32_t index = SizeClass::Index(size);
+        if (index == SizeClass::npos) return false;
+        return proxies[index]->Deallocate(ptr);
+    }
+
+    IBlockGroupProxy& Group(std::size_t index){
+        return *proxies[index];
+    }
 
+private:
+    BlockPool(){
+        static_for<SizeClass::num>([&](auto i) {
+            using config = SizeClass::config_at<decltype(i)::value>;
+            proxies[i] = std::make_unique<BlockGroupProxy<config::size, config::max_num>>();
+        });
+    }
 
+    std::array<std::unique_ptr<IBlockGroupProxy>, SizeClass::num> proxies;
+};
     
 
-// 负责大规模的内存分配
+// 负责大规模的内存分配: 一次向系统申请 chunk_bytes, 切分成 chunk_region_num 个 Region
+// note: chunk_bytes 是大页的整数倍, 通过 OS_AllocBigPage 映射, 起始地址至少按大页对齐, 也就满足 region_bytes 对齐
+struct Arena;
+
+constexpr std::size_t chunk_bytes = big_page_btye_size;
+constexpr std::size_t chunk_region_num = chunk_bytes / region_bytes;
+
 struct Chunk{
-    void * allocate(size_t size){
-        return nullptr;
+    Arena * arena = nullptr;
+    void * base = nullptr;      // comment: OS_AllocBigPage 返回的地址
+    char * regions = nullptr;   // comment: 第一个 Region 的地址
+    uint32_t used_num = 0;      // comment: 正被 bin 使用的 Region 数量
+    OSAllocator::PageKind page_kind = OSAllocator::PageKind::Normal;
+    steady_clock::time_point idle_since;  // comment: 放入 spare_chunks 的时间
+
+    static Chunk* Create(Arena* arena){
+        OSAllocator::PageKind kind;
+        // note: 绑定到创建它的线程所在的 NUMA 节点, 从映射缓存复用时连同驻留的页一起迁移过来
+        void * base = OSAllocator::OS_AllocBigPage(chunk_bytes, region_bytes, &kind, OSAllocator::CurrentNode);
+        Chunk * chunk = new Chunk();
+        chunk->arena = arena;
+        chunk->base = base;
+        chunk->regions = static_cast<char*>(base);
+        chunk->page_kind = kind;
+        return chunk;
+    }
+    static void Destroy(Chunk* chunk){
+        OSAllocator::OS_FreeBigPage(chunk->base, chunk_bytes, chunk->page_kind);
+        delete chunk;
     }
-    void deallocate(void * ptr, size_t size){
 
+    Region* GetRegion(std::size_t index) const {
+        return reinterpret_cast<Region*>(regions + index * region_bytes);
     }
-    
-};  
\ No newline at end of file
+    bool Contains(const Region* region) const {
+        const char* addr = reinterpret_cast<const char*>(region);
+        return addr >= regions && addr < regions + chunk_bytes;
+    }
+};
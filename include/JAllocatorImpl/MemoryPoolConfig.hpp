@@ -58,13 +58,6 @@ static constexpr std::tuple<
     MemConfig<64, 8192>,
     MemConfig<80, 8192>,
     MemConfig<96, 8192>,
-    MemConfig<16, 8192>,
-    MemConfig<24, 8192>,
-    MemConfig<32, 8192>,
-    MemConfig<48, 8192>,
-    MemConfig<64, 8192>,
-    MemConfig<80, 8192>,
-    MemConfig<96, 8192>,
     MemConfig<112, 8192>,
     MemConfig<128, 8192>,
     MemConfig<160, 4096>,
@@ -143,8 +136,6 @@ static constexpr std::tuple<
     MemConfig<15616, 1024>,
     MemConfig<16128, 1024>,
     MemConfig<16384, 1024>,
-    MemConfig<2*page_byte_size, 512>,
-    MemConfig<4*page_byte_size, 512>,
     MemConfig<8*page_byte_size, 512>,
     MemConfig<12*page_byte_size, 512>,
     MemConfig<16*page_byte_size, 512>,
@@ -172,10 +163,7 @@ static constexpr std::tuple<
     MemConfig<8*big_page_btye_size, 64>,
     MemConfig<16*big_page_btye_size, 32>,
     MemConfig<32*big_page_btye_size, 32>,
-    MemConfig<64*big_page_btye_size, 32>,
-    MemConfig<16*big_page_btye_size, 16>,
-    MemConfig<32*big_page_btye_size, 16>,
-    MemConfig<64*big_page_btye_size, 8>
+    MemConfig<64*big_page_btye_size, 32>
 > MemPoolConfig;
 
 
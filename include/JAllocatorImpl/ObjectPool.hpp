@@ -0,0 +1,111 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+#include "MemoryPoolConfig.hpp"
+#include "SizeClass.hpp"
+#include "Chunk.hpp"
+
+/*
+ * @function: 按类型在编译期选定 MemPoolConfig 中的 class, 每个类型独占一个定长块池
+ * @note: class 由 sizeof(T) / alignof(T) 在编译期算出, 运行时没有任何 class 查找
+ * @note: BlockGroup 中的块从按页对齐的基址开始, 以 sizeof(Block<Size>) 为步长排列,
+ * @note:    因此选择的 class 还要求步长是 alignof(T) 的倍数
+ * @note: 池耗尽(超过 MemConfig 的 max_num)时回退到全局 operator new, 释放时按地址判断归属
+ * @usage: Foo* foo = ObjectPool<Foo>::New(args...); ObjectPool<Foo>::Delete(foo);
+ *         std::list<Foo, PoolAllocator<Foo>> list;
+ */
+namespace ObjectPoolDetail {
+    constexpr std::size_t Stride(std::size_t size) {
+        return sizeof(Block<1>) > size ? sizeof(Block<1>) : (size + alignof(Block<1>) - 1) & ~(alignof(Block<1>) - 1);
+    }
+
+    // @function: 能容纳 size 且块地址满足 align 的最小 class, 不存在时返回 SizeClass::npos
+    constexpr uint32_t ClassFor(std::size_t size, std::size_t align) {
+        const uint32_t first = SizeClass::Index(size);
+        if (first == SizeClass::npos || align > page_byte_size) return SizeClass::npos;
+        for (uint32_t i = first; i < SizeClass::num; ++i) {
+            if (Stride(SizeClass::sizes[i]) % align == 0) return i;
+        }
+        return SizeClass::npos;
+    }
+}
+
+template <typename T>
+class ObjectPool{
+public:
+    static constexpr uint32_t class_index = ObjectPoolDetail::ClassFor(sizeof(T), alignof(T));
+    static_assert(class_index != SizeClass::npos, "no MemPoolConfig class fits sizeof(T) / alignof(T)");
+
+    using config = SizeClass::config_at<class_index>;
+    using proxy_type = BlockGroupProxy<config::size, config::max_num>;
+    static constexpr std::size_t block_size = config::size;
+    static constexpr std::size_t max_num = config::max_num;
+
+    // @function: 取一块能放下一个 T 的内存, 不构造对象
+    static void* Allocate(){
+        if (void* ptr = pool.Allocate()) [[likely]] return ptr;
+        return ::operator new(sizeof(T), std::align_val_t{alignof(T)});
+    }
+
+    static void Deallocate(void* ptr) noexcept {
+        if (!ptr) return;
+        if (pool.Deallocate(ptr)) [[likely]] return;
+        ::operator delete(ptr, std::align_val_t{alignof(T)});
+    }
+
+    template <typename... Args>
+    static T* New(Args&&... args){
+        void* ptr = Allocate();
+        try {
+            return ::new (ptr) T(std::forward<Args>(args)...);
+        } catch (...) {
+            Deallocate(ptr);
+            throw;
+        }
+    }
+
+    static void Delete(T* obj) noexcept {
+        if (!obj) return;
+        obj->~T();
+        Deallocate(obj);
+    }
+
+private:
+    // note: 每个 T 一个静态池, 与 BlockPool 中同一 class 的池互不共享
+    inline static proxy_type pool;
+};
+
+// @function: 单个元素的分配走 ObjectPool<T>, 一次分配多个元素(如 vector)直接使用 operator new
+template <typename T>
+class PoolAllocator{
+public:
+    using value_type = T;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using propagate_on_container_move_assignment = std::true_type;
+
+    PoolAllocator() noexcept = default;
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>&) noexcept {}
+
+    T* allocate(std::size_t n){
+        if (n == 1) [[likely]] return static_cast<T*>(ObjectPool<T>::Allocate());
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{alignof(T)}));
+    }
+
+    void deallocate(T* ptr, std::size_t n) noexcept {
+        if (n == 1) [[likely]] {
+            ObjectPool<T>::Deallocate(ptr);
+            return;
+        }
+        ::operator delete(ptr, std::align_val_t{alignof(T)});
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) noexcept { return true; }
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) noexcept { return false; }
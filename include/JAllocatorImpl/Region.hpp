@@ -0,0 +1,214 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <bit>
+#include <chrono>
+#include <functional>
+#include <vector>
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+#include "MemoryPoolConfig.hpp"
+
+struct Chunk;
+
+// 一个 Region 由 region_num 个连续的 page 组成, 起始地址按 region_bytes 对齐
+constexpr std::size_t region_bytes = static_cast<std::size_t>(region_num) * page;
+// 最小的 slot 大小, 决定 Region 内 bitmap 的容量
+constexpr std::size_t region_min_slot = 16;
+constexpr std::size_t region_bitmap_words = region_bytes / region_min_slot / 64;
+// note: AVX2 一次检查 4 个字, bitmap 的长度必须是 4 的倍数
+static_assert(region_bitmap_words % 4 == 0, "region bitmap must be a whole number of 256-bit lanes");
+
+/*
+ * @function: 同一 size class 的一段连续内存, 头部之后切分成 slot_num 个 slot
+ * @note: bitmap 中置 1 的位表示对应 slot 空闲, 用 countr_zero 找到第一个空闲 slot
+ * @note: 小 slot 的 bitmap 很长, 开启 AVX2 时每次跳过 256 位全零的部分
+ * @note: alloc_batch 一次取出多个 slot, reset 把整个 Region 一次性标记为空闲
+ * @note: 由于按 region_bytes 对齐, 任意 slot 地址都能直接算出所属 Region
+ */
+struct Region {
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    Chunk* chunk = nullptr;
+    uint32_t bin_index = 0;
+    uint32_t slot_size = 0;
+    uint32_t slot_num = 0;
+    uint32_t free_num = 0;
+    uint32_t heap_index = npos;  // 在 RegionHeap 中的下标, npos 表示不在堆中
+    uint32_t hint = 0;           // 第一个可能含有空闲 slot 的 bitmap 字
+    char* slots = nullptr;
+    bool purged = false;         // 空闲期间头部之外的页已还给系统
+    std::chrono::steady_clock::time_point idle_since;  // 放入 avail_runs 的时间
+    uint64_t bitmap[region_bitmap_words];
+
+    void init(uint32_t bin_index_, uint32_t slot_size_) {
+        bin_index = bin_index_;
+        slot_size = slot_size_;
+        // note: 大于一页的 slot 按页对齐, 其余按 cache line 对齐
+        const std::size_t align = slot_size >= page ? page : 64;
+        const std::size_t offset = (sizeof(Region) + align - 1) & ~(align - 1);
+        slots = reinterpret_cast<char*>(this) + offset;
+        slot_num = static_cast<uint32_t>((region_bytes - offset) / slot_size);
+        free_num = slot_num;
+        heap_index = npos;
+        purged = false;
+        reset();
+    }
+
+    // @function: 把所有 slot 标记为空闲, 不逐个释放; 之前分配出去的 slot 全部失效
+    void reset() {
+        free_num = slot_num;
+        hint = 0;
+        const uint32_t full_words = slot_num / 64;
+        for (uint32_t i = 0; i < region_bitmap_words; ++i) {
+            bitmap[i] = i < full_words ? ~uint64_t{0} : 0;
+        }
+        if (slot_num % 64) {
+            bitmap[full_words] = (uint64_t{1} << (slot_num % 64)) - 1;
+        }
+    }
+
+    // @function: 取出地址最低的空闲 slot, 调用方保证 !full()
+    void* alloc() {
+        const uint32_t word = next_word(hint);
+        const uint32_t bit = static_cast<uint32_t>(std::countr_zero(bitmap[word]));
+        bitmap[word] &= bitmap[word] - 1;
+        hint = word;
+        --free_num;
+        return slot_at(word, bit);
+    }
+
+    /*
+     * @function: 按地址从低到高取出至多 n 个空闲 slot 写入 out, 返回取到的个数
+     * @note: 每个 bitmap 字只读写一次, 该字中的空闲位不够时整字清零
+     */
+    uint32_t alloc_batch(void** out, uint32_t n) {
+        n = n < free_num ? n : free_num;
+        uint32_t got = 0;
+        uint32_t word = hint;
+        while (got < n) {
+            word = next_word(word);
+            uint64_t bits = bitmap[word];
+            while (bits && got < n) {
+                out[got++] = slot_at(word, static_cast<uint32_t>(std::countr_zero(bits)));
+                bits &= bits - 1;
+            }
+            bitmap[word] = bits;
+        }
+        hint = word;
+        free_num -= n;
+        return n;
+    }
+
+    void free(void* ptr) {
+        const std::size_t index = static_cast<std::size_t>(static_cast<char*>(ptr) - slots) / slot_size;
+        const uint32_t word = static_cast<uint32_t>(index / 64);
+        bitmap[word] |= uint64_t{1} << (index % 64);
+        if (word < hint) hint = word;
+        ++free_num;
+    }
+
+    bool full() const noexcept { return free_num == 0; }
+    bool empty() const noexcept { return free_num == slot_num; }
+
+    void* slot_at(uint32_t word, uint32_t bit) const noexcept {
+        return slots + (static_cast<std::size_t>(word) * 64 + bit) * slot_size;
+    }
+
+    // @function: 从 word 开始第一个非零的 bitmap 字, 调用方保证存在
+    uint32_t next_word(uint32_t word) const noexcept {
+    #if defined(__AVX2__)
+        while (word % 4 && !bitmap[word]) ++word;
+        if (word % 4 == 0) {
+            for (;; word += 4) {
+                const __m256i lane = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bitmap + word));
+                if (!_mm256_testz_si256(lane, lane)) break;
+            }
+        }
+    #endif
+        while (!bitmap[word]) ++word;
+        return word;
+    }
+
+    static Region* from_ptr(const void* ptr) {
+        return reinterpret_cast<Region*>(
+            reinterpret_cast<uintptr_t>(ptr) & ~(uintptr_t{region_bytes} - 1)
+        );
+    }
+};
+
+/*
+ * @function: 按地址排序的 Region 小顶堆, 堆顶是地址最低的非满 Region
+ * @note: 总是优先从低地址分配, 让高地址的 Region 有机会整体空闲下来, 减少碎片
+ * @note: Region 记录自己在堆中的下标, 因此可以 O(log n) 删除任意 Region
+ */
+class RegionHeap {
+public:
+    bool empty() const noexcept { return heap.empty(); }
+    std::size_t size() const noexcept { return heap.size(); }
+    Region* top() const noexcept { return heap.front(); }
+
+    bool contains(const Region* region) const noexcept {
+        return region->heap_index != Region::npos;
+    }
+
+    void push(Region* region) {
+        heap.push_back(region);
+        sift_up(heap.size() - 1);
+    }
+
+    Region* pop() {
+        Region* region = heap.front();
+        erase(region);
+        return region;
+    }
+
+    void erase(Region* region) {
+        const std::size_t index = region->heap_index;
+        Region* last = heap.back();
+        heap.pop_back();
+        region->heap_index = Region::npos;
+        if (last == region) return;
+        place(index, last);
+        sift_down(index);
+        sift_up(last->heap_index);
+    }
+
+private:
+    std::vector<Region*> heap;
+
+    static bool lower(const Region* lhs, const Region* rhs) noexcept {
+        return std::less<const Region*>{}(lhs, rhs);
+    }
+
+    void place(std::size_t index, Region* region) {
+        heap[index] = region;
+        region->heap_index = static_cast<uint32_t>(index);
+    }
+
+    void sift_up(std::size_t index) {
+        Region* region = heap[index];
+        while (index > 0) {
+            const std::size_t parent = (index - 1) / 2;
+            if (lower(heap[parent], region)) break;
+            place(index, heap[parent]);
+            index = parent;
+        }
+        place(index, region);
+    }
+
+    void sift_down(std::size_t index) {
+        Region* region = heap[index];
+        const std::size_t n = heap.size();
+        while (true) {
+            std::size_t child = index * 2 + 1;
+            if (child >= n) break;
+            if (child + 1 < n && lower(heap[child + 1], heap[child])) ++child;
+            if (lower(region, heap[child])) break;
+            place(index, heap[child]);
+            index = child;
+        }
+        place(index, region);
+    }
+};
@@ -0,0 +1,130 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+
+#include "MemoryPoolConfig.hpp"
+#include "../static_for.hpp"
+
+/*
+ * @function: 由 MemPoolConfig 在编译期生成 size class 表
+ * @note: 编译期校验: size 严格递增(有序且无重复), 满足对齐规则
+ * @note: size -> class 的映射由查表完成, 热路径上没有循环与比较链
+ * @usage: uint32_t idx = SizeClass::SmallIndex(size);
+ *         std::size_t real = SizeClass::sizes[idx];
+ */
+namespace SizeClass {
+
+using config_type = std::remove_cvref_t<decltype(MemPoolConfig)>;
+constexpr std::size_t num = std::tuple_size_v<config_type>;
+constexpr uint32_t npos = UINT32_MAX;
+
+// note: 查表粒度. 不超过 lookup_grain 的 tiny class 必须是 1, 2, 4 ... lookup_grain,
+// note: 其余 class 必须是 lookup_grain 的倍数, 大于 small_alloc 的 class 必须按页对齐
+constexpr std::size_t lookup_grain = 8;
+
+namespace detail {
+    template <typename Field>
+    constexpr auto Collect(Field field) {
+        std::array<std::size_t, num> values{};
+        static_for<num>([&](auto i) {
+            values[i] = field(std::tuple_element_t<decltype(i)::value, config_type>{});
+        });
+        return values;
+    }
+}
+
+constexpr std::array<std::size_t, num> sizes =
+    detail::Collect([](auto config) { return decltype(config)::size; });
+constexpr std::array<std::size_t, num> max_nums =
+    detail::Collect([](auto config) { return decltype(config)::max_num; });
+
+namespace detail {
+    constexpr bool IsStrictlyIncreasing() {
+        for (std::size_t i = 1; i < num; ++i) {
+            if (sizes[i - 1] >= sizes[i]) return false;
+        }
+        return true;
+    }
+
+    constexpr bool IsAligned() {
+        std::size_t expect_tiny = 1;
+        for (std::size_t size : sizes) {
+            if (size <= lookup_grain) {
+                if (size != expect_tiny) return false;
+                expect_tiny <<= 1;
+            } else if (size % lookup_grain != 0) {
+                return false;
+            } else if (size > small_alloc && size % page_byte_size != 0) {
+                return false;
+            }
+        }
+        return expect_tiny > lookup_grain;
+    }
+
+    constexpr std::size_t CountUpTo(std::size_t limit) {
+        return static_cast<std::size_t>(std::count_if(
+            sizes.begin(), sizes.end(), [limit](std::size_t s) { return s <= limit; }
+        ));
+    }
+
+    // @function: 生成 [0, limit] 内以 grain 为粒度的稠密表, 表项为能容纳该大小的最小 class
+    template <std::size_t Limit, std::size_t Grain>
+    constexpr auto MakeLookup() {
+        std::array<uint8_t, Limit / Grain + 1> table{};
+        std::size_t cls = 0;
+        for (std::size_t i = 0; i < table.size(); ++i) {
+            while (sizes[cls] < i * Grain) ++cls;
+            table[i] = static_cast<uint8_t>(cls);
+        }
+        return table;
+    }
+}
+
+static_assert(num > 0, "MemPoolConfig must not be empty");
+static_assert(num <= UINT8_MAX, "size class index must fit in the uint8_t lookup tables");
+static_assert(detail::IsStrictlyIncreasing(),
+    "MemPoolConfig sizes must be sorted in ascending order without duplicates");
+static_assert(detail::IsAligned(),
+    "MemPoolConfig sizes violate the size class alignment rules");
+static_assert(sizes.back() >= large_alloc, "MemPoolConfig must cover large_alloc");
+static_assert(std::find(sizes.begin(), sizes.end(), small_alloc) != sizes.end(),
+    "small_alloc must be a size class boundary");
+static_assert(std::find(sizes.begin(), sizes.end(), large_alloc) != sizes.end(),
+    "large_alloc must be a size class boundary");
+
+// note: (lookup_grain, small_alloc] 按 lookup_grain 查表; (small_alloc, large_alloc] 按页查表
+constexpr auto small_lookup = detail::MakeLookup<small_alloc, lookup_grain>();
+constexpr auto large_lookup = detail::MakeLookup<large_alloc, page_byte_size>();
+// note: 大于 large_alloc 的 class 数量很少, 二分查找即可
+constexpr std::size_t huge_begin = detail::CountUpTo(large_alloc);
+
+// @function: size in [0, small_alloc], 热路径使用, 无分支
+constexpr uint32_t SmallIndex(std::size_t size) noexcept {
+    const std::size_t tiny = size | (size == 0);
+    const uint32_t tiny_index = static_cast<uint32_t>(std::bit_width(tiny - 1));
+    const uint32_t table_index = small_lookup[(size + lookup_grain - 1) / lookup_grain];
+    return size <= lookup_grain ? tiny_index : table_index;
+}
+
+// @function: 返回能容纳 size 的最小 class, 超过最大 class 返回 npos
+constexpr uint32_t Index(std::size_t size) noexcept {
+    if (size <= small_alloc) [[likely]] {
+        return SmallIndex(size);
+    }
+    if (size <= large_alloc) {
+        return large_lookup[(size + page_byte_size - 1) / page_byte_size];
+    }
+    auto it = std::lower_bound(sizes.begin() + huge_begin, sizes.end(), size);
+    return it == sizes.end() ? npos : static_cast<uint32_t>(it - sizes.begin());
+}
+
+// @function: 第 Index 个 class 对应的 MemConfig
+template <std::size_t Index>
+using config_at = std::tuple_element_t<Index, config_type>;
+
+}
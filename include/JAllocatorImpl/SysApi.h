@@ -8,6 +8,7 @@
 #include <bit>
 #include <iostream>
 #include <algorithm>
+#include <chrono>
 #if defined(_WIN32)
     #include <windows.h>
     #include <winnt.h>
@@ -40,62 +41,87 @@
     #define MEM_NATIVE_PROT_NO_ACCESS         PROT_NONE
 #endif
 
-#ifdef _WIN32
-    #define OS_EXTRA_CHECK_ALIGNMENT(alignment) do{                                 \
-        SYSTEM_INFO sys_info;                                                       \
-        GetSystemInfo(&sys_info);                                                   \
-        assert((alignment) >= (sys_info.dwAllocationGranularity)                    \
-                && "Alignment must be >= system allocation granularity on Windows");\
-        printf(                                                                     \
-            "Alignment is %zu, and System allocation granularity is %zu",           \
-            static_cast<std::size_t>(alignment),                                    \
-            static_cast<std::size_t>(sys_info.dwAllocationGranularity)              \
-        );                                                                          \
-    }while(0)
-#else
-    #include <unistd.h>
-    #define OS_EXTRA_CHECK_ALIGNMENT(alignment) do {                                \
-        std::size_t page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));    \
-        assert(                                                                     \
-            (alignment) >= page_size &&                                             \
-            "Alignment must be >= system page size on POSIX systems"                \
-        );                                                                          \
-        printf("Alignment = %zu, System page size = %zu\n",                         \
-            static_cast<size_t>(alignment), page_size);                             \
-    }while(0)
-#endif 
-
-
 #ifdef NDEBUG
     #define CHECK_ALIGNMENT(alignment) ((void)0)
 #else /* 检查是否为2的幂且大于0 */ 
     #define CHECK_ALIGNMENT(alignment) do {                                         \
         assert(((alignment) > 0) && (((alignment) & ((alignment) - 1)) == 0)        \
             && "Alignment must be a power of 2 and greater than 0");                \
-        OS_EXTRA_CHECK_ALIGNMENT(alignment);                                        \
     } while(0)
 #endif
 
 
 namespace OSAllocator {
-    struct AllocHeader{
-        void * base_ptr;
-        size_t total_size;
-    };
+    // note: OS_Alloc / OS_AllocBigPage 的 node 参数除了节点号, 还可以取以下两个值
+    constexpr size_t AnyNode = static_cast<size_t>(-1);      // comment: 不绑定, 沿用系统默认的首次访问策略
+    constexpr size_t CurrentNode = static_cast<size_t>(-2);  // comment: 调用线程当前所在的 NUMA 节点
+
     /*
      * @function: 封装 OS 底层的内存分配接口
      * @param: size 字节数 
      * @param: alignment 对齐值, 默认是 alignof(std::max_align_t)
      * @note: Release 下不做任何检查, 
      * @note: Debug 要求: alignment 是 2的幂次 && 大于零
-     * @note:    Windows 下不能超过 dwAllocationGranularity, 一般是 64KB (VirtualAlloc)
-     * @note:    Linux   下不能超过要一个 page_size, 一般是 4KB (mmap)
+     * @note: 不小于一页的请求单独映射 RoundUp(size, page) 字节, 返回映射的起始地址, 不带头部
+     * @note:    对齐超过映射粒度时多保留 alignment - page 字节, 再解除首尾未对齐的部分, 不会多占一个对齐单位
+     * @note: 映射的大小由 OS_Free 的 size 推出, 因此 OS_Free 的 size 必须与分配时一致
+     * @param: node 映射的物理页优先从该 NUMA 节点分配(mbind MPOL_PREFERRED); 不足一页的请求来自堆, 不绑定
+     * @note: 从映射缓存复用时, 已经驻留的页一并迁移到 node
     */
-    void* OS_Alloc(size_t size, size_t alignment = alignof(std::max_align_t));
-    void* OS_AllocBigPage(size_t size, size_t alignment = alignof(std::max_align_t));
+    void* OS_Alloc(size_t size, size_t alignment = alignof(std::max_align_t), size_t node = AnyNode);
     void OS_Free(void* ptr, size_t size = 0);
     size_t GetPageSize();
 
+    /*
+     * @function: 只保留 RoundUp(size, page) 字节的地址空间, 不可访问, 不计入提交额度, 失败时抛出 std::bad_alloc
+     * @note: 之后用 OS_Commit 按需把其中的一段变为可读写, 用 OS_Release 整段释放, 不经过映射缓存
+     * @param: node 与 OS_Alloc 相同, 之后提交的页从该节点分配
+     */
+    void* OS_Reserve(size_t size, size_t alignment = alignof(std::max_align_t), size_t node = AnyNode);
+    // @function: 把 OS_Reserve 保留的 [ptr, ptr + size) 变为可读写, ptr 与 size 按页对齐; 超出提交额度时返回 false
+    bool OS_Commit(void* ptr, size_t size);
+    // @function: 释放 OS_Reserve 得到的整段地址, size 与保留时一致
+    void OS_Release(void* ptr, size_t size);
+
+    // note: OS_AllocBigPage 实际拿到的页类型
+    enum class PageKind {
+        HugeTLB,     // comment: 预留的大页(MAP_HUGETLB / MEM_LARGE_PAGES)
+        Transparent, // comment: 大页对齐的普通映射, 已 madvise(MADV_HUGEPAGE) 交给 THP
+        Normal,      // comment: 普通页
+    };
+    /*
+     * @function: 优先使用大页的内存分配, 大页不可用时逐级回退, 不会因为没有大页而失败
+     * @param: alignment 对齐值, 不小于一个大页的请求至少按大页对齐
+     * @param: kind 非空时写入实际使用的页类型
+     * @param: node 与 OS_Alloc 相同, 映射绑定到的 NUMA 节点
+     * @note: 必须用 OS_FreeBigPage 释放, 且 size 与分配时一致
+     * @note: 优先复用映射缓存中同样对齐的映射, 此时 kind 为该映射最初的页类型
+     */
+    void* OS_AllocBigPage(
+        size_t size,
+        size_t alignment = alignof(std::max_align_t),
+        PageKind* kind = nullptr,
+        size_t node = AnyNode
+    );
+    // @param: kind 分配时得到的页类型, 映射进入缓存后复用时原样返回
+    void OS_FreeBigPage(void* ptr, size_t size, PageKind kind = PageKind::Normal);
+    size_t GetHugePageSize();
+    /*
+     * @function: 把 [ptr, ptr + size) 的物理页还给系统, 映射保持有效, 之后读到的是零页
+     * @note: ptr 和 size 必须按页对齐; HugeTLB 映射只能整页归还, 调用方应跳过
+     */
+    void OS_Purge(void* ptr, size_t size);
+
+    /*
+     * @function: 大块映射缓存: OS_Free / OS_FreeBigPage 不立即解除映射, 按大小分组保留以供复用
+     * @note: 容量默认 64MB, 超出时解除最大的映射; 容量设为 0 关闭缓存并释放已缓存的映射
+     * @note: 复用的映射内容不确定, 与 OS_Alloc 一样不保证为零
+     */
+    void SetMappingCacheLimit(size_t bytes);
+    size_t GetMappingCacheBytes();
+    // @function: 解除缓存中空闲时长不小于 min_idle 的映射, 返回释放的字节数
+    size_t TrimMappingCache(std::chrono::milliseconds min_idle = std::chrono::milliseconds(0));
+
 }
 
 // inline void* OS_Alloc(size_t size) {
@@ -7,126 +7,1213 @@
 #include <vector>
 #include <bit>
 #include <mutex>
+#include <thread>
 #include <memory_resource>
 #include <atomic>
 #include <new>
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
+#include <chrono>
+#include <condition_variable>
 
-#if defined(_WIN32)
-#include <windows.h>
-#else
-#include <sys/mman.h>
-#include <unistd.h>
-#endif
+#include "JAllocatorImpl/MemoryPoolConfig.hpp"
+#include "SAllocatorImpl/OSMemory.hpp"
+#include "SAllocatorImpl/PageMap.hpp"
+#include "SAllocatorImpl/VirtualHeap.hpp"
+#include "SAllocatorImpl/CentralFreeList.hpp"
+#include "SAllocatorImpl/Numa.hpp"
 
 namespace Stellatus {
 
 constexpr size_t ALIGNMENT = alignof(std::max_align_t);
-constexpr size_t MAX_FAST_SIZE = 1024; // 提升 fastbin 支持容量到 1024 bytes
-constexpr size_t NUM_FAST_BINS = MAX_FAST_SIZE / ALIGNMENT;
+constexpr size_t MAX_SMALL_SIZE = small_alloc;  // 不超过 16KB 的对象从 slab 切分, 不带头部
+constexpr size_t MAX_CACHED_SIZE = large_alloc; // 16KB~4MB 的块带头部单独映射, 释放后按 class 缓存
+#ifdef SALLOCATOR_MALLOC_OVERRIDE
+// note: 作为全局 malloc 编译时不能再回到 libc 的堆, 超过 MAX_CACHED_SIZE 的块全部单独映射
+constexpr size_t MMAP_THRESHOLD = MAX_CACHED_SIZE + 1;
+#else
 constexpr size_t MMAP_THRESHOLD = 1ULL << 30; // 超过 1GB 使用大块分配
+#endif
 constexpr size_t MAX_ALLOC_SIZE = 8ULL << 30; // 支持最多分配 8GB
+constexpr size_t SLAB_SIZE = 64 << 10; // fastbin 为空时至少向系统申请 64KB 切分成同尺寸的块
+constexpr size_t SLAB_MIN_OBJECTS = 8; // 大对象的 slab 至少能切出 8 个
+constexpr size_t TRANSFER_BYTES = 64 << 10; // 线程缓存与中心链表之间一次搬运的字节数
+constexpr size_t MAX_TRANSFER_OBJECTS = 32; // 一次搬运的对象数上限
+constexpr size_t THREAD_CACHE_CLASS_BYTES = 256 << 10; // 每个 class 的线程缓存字节上限
+constexpr size_t CENTRAL_SHARDS = 8; // 中心链表的分片数
+constexpr size_t MAX_NATURAL_ALIGN = 4096; // slab 中的对象按 class 大小的最低位自然对齐, 最多按页对齐
+constexpr size_t BLOCK_ALIGN = 64; // 16KB~4MB 的块数据按 64 字节对齐
+constexpr size_t OS_ALIGNMENT = 4096; // os_alloc 返回的地址至少按 4KB 对齐
 
-inline size_t align_up(size_t size, size_t align = ALIGNMENT) {
+constexpr size_t align_up(size_t size, size_t align = ALIGNMENT) {
     return (size + align - 1) & ~(align - 1);
 }
 
-inline void* os_alloc(size_t size) {
-#if defined(_WIN32)
-    void* ptr = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
-    if (ptr) std::memset(ptr, 0, size); // 强制触发物理页分配
-    return ptr;
-#else
-    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    if (ptr != MAP_FAILED) std::memset(ptr, 0, size); // 强制触发物理页分配
-    return (ptr == MAP_FAILED) ? nullptr : ptr;
-#endif
+/*
+ * @function: log-linear 的 size class, 每个 2 的幂区间再均分成 4 个 class
+ * @note: 16, 32, 48, 64 | 80, 96, 112, 128 | 160, 192, 224, 256 | ... | 4MB
+ * @note: 以 16 字节为单位 u = ceil(size / 16), 令 k = bit_width((u - 1) | 4), shift = k - 3
+ * @note: 则 index = 4 * shift + ((u - 1) >> shift), 用 countl_zero 计算, 没有分支
+ * @note: 相邻 class 的内部碎片不超过 25%
+ */
+constexpr size_t size_to_index(size_t size) noexcept {
+    const uint64_t unit = ((size | (size == 0)) + ALIGNMENT - 1) / ALIGNMENT - 1;
+    const unsigned shift = 64 - std::countl_zero(unit | 4) - 3;
+    return size_t{4} * shift + (unit >> shift);
 }
 
-inline void os_free(void* ptr, size_t size) {
-#if defined(_WIN32)
-    VirtualFree(ptr, 0, MEM_RELEASE);
-#else
-    munmap(ptr, size);
-#endif
+constexpr size_t index_to_size(size_t idx) noexcept {
+    if (idx < 4) return (idx + 1) * ALIGNMENT;
+    const size_t shift = idx / 4 - 1;
+    return ALIGNMENT * ((idx % 4 + 5) << shift);
+}
+
+constexpr size_t NUM_SIZE_CLASSES = size_to_index(MAX_CACHED_SIZE) + 1;
+constexpr size_t MAX_SMALL_INDEX = size_to_index(MAX_SMALL_SIZE);
+
+/*
+ * @function: 满足 align 对齐的最小 class, align 为大于 ALIGNMENT 且不超过 MAX_NATURAL_ALIGN 的 2 的幂
+ * @note: slab 中的对象按 class 大小的最低位对齐, 只要 class 大小是 align 的倍数, 切出的每个对象都满足对齐
+ * @note: 每 4 个 class 中有一个是 2 的幂, 最多向上走 3 个 class; 超过 MAX_SMALL_INDEX 的块统一按 BLOCK_ALIGN 对齐
+ */
+constexpr size_t aligned_size_to_index(size_t size, size_t align) noexcept {
+    size_t idx = size_to_index(size > align ? size : align);
+    while (idx <= MAX_SMALL_INDEX && index_to_size(idx) % align) ++idx;
+    return idx;
 }
 
+static_assert(index_to_size(MAX_SMALL_INDEX) == MAX_SMALL_SIZE);
+static_assert(index_to_size(NUM_SIZE_CLASSES - 1) == MAX_CACHED_SIZE);
+static_assert([] {
+    for (size_t idx = 0; idx < NUM_SIZE_CLASSES; ++idx) {
+        if (size_to_index(index_to_size(idx)) != idx) return false;
+        if (size_to_index(index_to_size(idx) + 1) != idx + 1) return false;
+    }
+    return true;
+}(), "size_to_index and index_to_size must be inverse of each other");
+
+// @function: idx 号 class 每次切分的 slab 大小
+constexpr size_t slab_size_of(size_t idx) noexcept {
+    const size_t want = std::bit_ceil(index_to_size(idx) * SLAB_MIN_OBJECTS);
+    return want > SLAB_SIZE ? want : SLAB_SIZE;
+}
+
+// @function: idx 号 class 一次搬运的对象数, 小对象 32 个一批, 大对象至少 1 个
+constexpr size_t batch_size_of(size_t idx) noexcept {
+    const size_t num = TRANSFER_BYTES / index_to_size(idx);
+    return num < 1 ? 1 : (num > MAX_TRANSFER_OBJECTS ? MAX_TRANSFER_OBJECTS : num);
+}
+
+// @function: idx 号 class 在线程缓存中最多保留的对象数, 至少能放下一批
+constexpr size_t cache_capacity_of(size_t idx) noexcept {
+    const size_t batch = batch_size_of(idx);
+    const size_t num = THREAD_CACHE_CLASS_BYTES / index_to_size(idx);
+    return num < batch ? batch : (num > 4 * batch ? 4 * batch : num);
+}
+
+// note: 热路径上查表, 避免除法
+constexpr auto batch_sizes = [] {
+    std::array<uint32_t, NUM_SIZE_CLASSES> table{};
+    for (size_t idx = 0; idx < NUM_SIZE_CLASSES; ++idx) {
+        table[idx] = static_cast<uint32_t>(batch_size_of(idx));
+    }
+    return table;
+}();
+
+constexpr auto cache_capacities = [] {
+    std::array<uint32_t, NUM_SIZE_CLASSES> table{};
+    for (size_t idx = 0; idx < NUM_SIZE_CLASSES; ++idx) {
+        table[idx] = static_cast<uint32_t>(cache_capacity_of(idx));
+    }
+    return table;
+}();
+
+// note: 大块映射(>= MMAP_THRESHOLD)使用的提交策略, 可由调用方按需调整
+inline constinit std::atomic<CommitPolicy> large_commit_policy{CommitPolicy::Lazy};
+
+inline void set_commit_policy(CommitPolicy policy) noexcept {
+    large_commit_policy.store(policy, std::memory_order_relaxed);
+}
+
+// note: 小对象(<= MAX_SMALL_SIZE)不携带头部, 由所在页的 SlabMeta 给出 size class 和所属节点
+// note: SlabMeta 放在 slab 起始处; slab 优先从 slab_heap 切出, 按 granule 登记
+// note: slab_heap 保留区耗尽时 slab 单独映射, 覆盖的每一页在 page_map 中登记为指向它
+struct SlabMeta {
+    uint16_t size_class;
+    uint16_t node;            // comment: slab 的物理页所在的 NUMA 节点, 即切出它的 Arena 的节点
+    uint32_t object_size;
+    uint32_t object_count;    // comment: slab 切出的对象总数
+    uint32_t scan_free;       // comment: 仅 Decay 使用, 本轮在空闲对象中数到的个数
+    SlabMeta* next_retired;   // comment: 物理页已归还后, 在 retired_slabs 中的链表指针
+};
+
+// @function: 大小为 size 的对象在 slab 中的起始偏移, 使每个对象都按 size 的最低位(最多一页)对齐
+// @note: slab 本身至少按页对齐, 偏移是该对齐的倍数, 之后每个对象相隔 size 字节, 对齐保持不变
+constexpr size_t slab_object_offset(size_t size) noexcept {
+    const size_t lowbit = size & (~size + 1);
+    const size_t natural = lowbit < MAX_NATURAL_ALIGN ? lowbit : MAX_NATURAL_ALIGN;
+    return align_up(sizeof(SlabMeta), natural > ALIGNMENT ? natural : ALIGNMENT);
+}
+
+static_assert([] {
+    for (size_t idx = 0; idx <= MAX_SMALL_INDEX; ++idx) {
+        const size_t offset = slab_object_offset(index_to_size(idx));
+        if ((slab_size_of(idx) - offset) / index_to_size(idx) < SLAB_MIN_OBJECTS / 2) return false;
+    }
+    return true;
+}(), "natural alignment must not waste most of a slab");
+
+// note: 超过 MAX_SMALL_SIZE 的块带有 Chunk 头部, 这些块在 slab_heap 和 page_map 中都查不到
+// note: 不超过 MAX_CACHED_SIZE 的块 size 记录的是 class 大小, 释放后进入 fastbin
+// note: 头部紧贴数据之前; 为了对齐, 头部前面可能有填充, offset 记录头部距这次分配起始地址的字节数
 struct Chunk {
     size_t size;
-    Chunk* next;
+    // comment: 头部到底层分配起始地址的距离; 用户态地址不超过 48 位, 高 16 位记录块所属的 NUMA 节点
+    size_t offset : 48;
+    size_t node : 16;
 
     void* data() { return reinterpret_cast<void*>(this + 1); }
+    void* base() { return reinterpret_cast<char*>(this) - offset; }
+    // comment: 这次分配的总字节数, 即填充 + 头部 + 数据
+    size_t total() const noexcept { return offset + sizeof(Chunk) + size; }
     static Chunk* from_data(void* ptr) {
         return reinterpret_cast<Chunk*>(ptr) - 1;
     }
+
+    // @function: 让数据按 align 对齐时头部与填充最多共占的字节数, 与底层分配的起始地址无关
+    static constexpr size_t prefix(size_t align) noexcept {
+        return align > sizeof(Chunk) ? align : sizeof(Chunk);
+    }
+
+    // @function: 在 raw 开始的一次分配中放置头部, 返回按 align 对齐的数据地址
+    // @param: node 块所属的 NUMA 节点, 只有参与缓存的块(16KB~4MB)按它归还
+    static void* place(void* raw, size_t size, size_t align, size_t node = 0) noexcept {
+        const uintptr_t base = reinterpret_cast<uintptr_t>(raw);
+        const uintptr_t data = (base + sizeof(Chunk) + align - 1) & ~uintptr_t(align - 1);
+        Chunk* chunk = from_data(reinterpret_cast<void*>(data));
+        chunk->size = size;
+        chunk->offset = static_cast<size_t>(reinterpret_cast<uintptr_t>(chunk) - base);
+        chunk->node = node;
+        return chunk->data();
+    }
+
+    /*
+     * @function: 在 mapped 字节的 os_alloc 映射中放置头部, 对齐超过一页时解除头部之前与数据之后多余的整页
+     * @note: 保证 base() 与 total() 恰好覆盖仍然保留的映射, 释放时 os_free(base(), total()) 不会漏掉尾部
+     * @note: Windows 的 VirtualFree 只能整段释放, 不裁剪, base() 仍是原映射的起始地址
+     */
+    static void* place_mapped(void* raw, size_t mapped, size_t size, size_t align, size_t node = 0) noexcept {
+        void* data = place(raw, size, align, node);
+#if !defined(_WIN32)
+        if (align > OS_ALIGNMENT) {
+            Chunk* chunk = from_data(data);
+            const uintptr_t begin = reinterpret_cast<uintptr_t>(raw);
+            const uintptr_t keep_begin = reinterpret_cast<uintptr_t>(chunk) & ~uintptr_t(OS_ALIGNMENT - 1);
+            const uintptr_t keep_end = align_up(reinterpret_cast<uintptr_t>(data) + size, OS_ALIGNMENT);
+            if (keep_begin > begin) os_free(raw, keep_begin - begin);
+            if (begin + mapped > keep_end) os_free(reinterpret_cast<void*>(keep_end), begin + mapped - keep_end);
+            chunk->offset = static_cast<size_t>(reinterpret_cast<uintptr_t>(chunk) - keep_begin);
+        }
+#endif
+        return data;
+    }
+};
+
+static_assert(sizeof(Chunk) == 16, "Chunk header must stay two words");
+
+// note: 全局状态都是常量初始化的, 替换 malloc 后, 早于任何动态初始化的分配也能使用
+inline constinit VirtualHeap<SlabMeta> slab_heap;
+inline constinit PageMap<SlabMeta> page_map;
+// note: 每个 NUMA 节点一组中心链表, Arena 只与自己节点的那一组交换对象
+inline constinit std::array<CentralFreeList<NUM_SIZE_CLASSES, CENTRAL_SHARDS>, MAX_NUMA_NODES> central_free_lists;
+// note: 其他节点上的线程释放的 slab 对象与 16KB~4MB 的块压回所属节点, 由该节点的 Arena 在慢路径上取走
+inline constinit std::array<FreeStack, MAX_NUMA_NODES> node_inboxes;
+// note: 用到过的最大节点号 + 1, Decay 只遍历这些节点的中心链表
+inline constinit std::atomic<size_t> node_limit{1};
+
+inline void note_node_used(size_t node) noexcept {
+    size_t limit = node_limit.load(std::memory_order_relaxed);
+    while (limit <= node && !node_limit.compare_exchange_weak(limit, node + 1, std::memory_order_relaxed)) {}
+}
+
+static_assert(SLAB_SIZE % VirtualHeap<SlabMeta>::GRANULE == 0, "slabs must fill whole granules");
+static_assert(NUM_SIZE_CLASSES <= UINT16_MAX && MAX_NUMA_NODES <= UINT16_MAX, "SlabMeta stores class and node in 16 bits");
+
+/*
+ * @function: 物理页已经还给系统的 slab, 按 slab 大小分链表, refill 时优先复用
+ * @note: slab 仍保留着地址和 slab_heap / page_map 中的登记, 首页(SlabMeta 所在页)不归还
+ */
+class RetiredSlabs {
+public:
+    static constexpr size_t NUM_SIZES = 8; // comment: SLAB_SIZE << 0 ... SLAB_SIZE << 7
+
+    void push(SlabMeta* meta, size_t slab_size) {
+        std::scoped_lock lock(mtx);
+        std::atomic_ref<SlabMeta*> head(heads[slot_of(slab_size)]);
+        meta->next_retired = head.load(std::memory_order_relaxed);
+        head.store(meta, std::memory_order_relaxed);
+    }
+
+    SlabMeta* pop(size_t slab_size) {
+        // note: 不加锁的预判, 绝大多数时候链表为空
+        std::atomic_ref<SlabMeta*> head(heads[slot_of(slab_size)]);
+        if (!head.load(std::memory_order_relaxed)) return nullptr;
+        std::scoped_lock lock(mtx);
+        SlabMeta* meta = head.load(std::memory_order_relaxed);
+        if (meta) head.store(meta->next_retired, std::memory_order_relaxed);
+        return meta;
+    }
+
+    // @function: fork 前持有 mtx, 之后在父子进程中各自释放, 见 prepare_fork
+    void fork_lock() { mtx.lock(); }
+    void fork_unlock() { mtx.unlock(); }
+
+private:
+    std::mutex mtx;
+    std::array<SlabMeta*, NUM_SIZES> heads{};
+
+    static size_t slot_of(size_t slab_size) noexcept {
+        return static_cast<size_t>(std::countr_zero(slab_size) - std::countr_zero(SLAB_SIZE));
+    }
 };
 
+inline constinit RetiredSlabs retired_slabs;
+
+static_assert(slab_size_of(MAX_SMALL_INDEX) <= (SLAB_SIZE << (RetiredSlabs::NUM_SIZES - 1)));
+
+// @note: 每次进入慢路径时调用, 距离上一轮衰减超过间隔时顺带执行一轮, 定义在 Decay 之后
+inline void decay_tick() noexcept;
+
+// @function: ptr 所在 slab 的元数据, 不是 slab 中的对象返回 nullptr
+// @note: slab_heap 内的地址按偏移直接换算, 只有保留区之外的地址才查 page_map
+inline SlabMeta* slab_meta_of(const void* ptr) noexcept {
+    if (slab_heap.contains(ptr)) [[likely]] return slab_heap.lookup(ptr);
+    return page_map.lookup(ptr);
+}
+
+// @function: 可缓存对象(slab 对象或 16KB~4MB 的块)所属的 size class, 用于把 node_inboxes 中混在一起的对象分回各个 class
+inline size_t cached_class_of(void* ptr) noexcept {
+    if (const SlabMeta* meta = slab_meta_of(ptr)) [[likely]] return meta->size_class;
+    return size_to_index(Chunk::from_data(ptr)->size);
+}
+
+// note: Arena 同一时刻只属于一个线程(owner), owner 线程上的 allocate/deallocate 不加锁
+// note: 任意线程分配的对象都由释放它的线程的 Arena::free 放入自己的 fastbin, 不退回分配它的 Arena
+// note: 每个 fastbin 最多缓存 cache_capacities[idx] 个对象, 超出时整批交给 central_free_list
+// note: fastbin 为空时先从 central_free_list 整批取回, 取不到才向系统申请新的 slab
+// note: 每个 Arena 属于一个 NUMA 节点: 新 slab 和块的物理页绑定到该节点, 只与该节点的中心链表交换对象
+// note: 节点内存耗尽时按距离从近到远向其他节点的中心链表借; 借来的对象释放时仍回到原节点
 class Arena {
 public:
-    Arena() = default;
+    explicit Arena(size_t numa_node = 0)
+        : owner(std::this_thread::get_id()),
+          shard(next_shard.fetch_add(1, std::memory_order_relaxed) % CENTRAL_SHARDS),
+          node(static_cast<uint16_t>(numa_node % MAX_NUMA_NODES)) {
+        note_node_used(node);
+    }
 
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // @function: 分配 size 字节, 仅允许 owner 线程调用
     void* allocate(size_t size) {
-        std::scoped_lock lock(mtx);
+        return allocate_impl(size, false);
+    }
+
+    // @function: 分配 size 字节并保证内容全零(calloc 语义), 仅允许 owner 线程调用
+    // @note: 新映射的大块内存本身就是零页, 不会再 memset 一遍
+    void* allocate_zeroed(size_t size) {
+        return allocate_impl(size, true);
+    }
+
+    /*
+     * @function: 分配 size 字节, 起始地址按 align 对齐, align 必须是 2 的幂, 仅允许 owner 线程调用
+     * @note: 不超过 MAX_SMALL_SIZE 时选一个大小是 align 倍数的 class, slab 按自然对齐切分, 不额外填充
+     * @note: 16KB~4MB 的块本身按 BLOCK_ALIGN 对齐, 更大的对齐单独映射一块, 释放后仍进入同一 class 的 fastbin
+     * @note: 必须用 Arena::free 或 reallocate 释放, 不能用按 size 计算 class 的 deallocate
+     */
+    void* allocate_aligned(size_t size, size_t align) {
+        return allocate_impl(size, false, align);
+    }
+
+    void* allocate_aligned_zeroed(size_t size, size_t align) {
+        return allocate_impl(size, true, align);
+    }
+
+    /*
+     * @function: 把 ptr 调整为 new_size 字节并保留原内容, ptr 可以由任意线程分配, 仅允许 owner 线程调用
+     * @note: 新大小不超过块的容量(所在 size class 的大小)且不小于其一半时原地返回
+     * @note: 超过 MAX_CACHED_SIZE 的块直接调整: 堆上的块交给 realloc, 映射的块用 mremap, 不复制数据
+     * @note: 其余情况分配新块复制后释放旧块; ptr 为空时等同 allocate, new_size 为 0 时释放 ptr 并返回 nullptr
+     * @param: align 结果的对齐要求, 原地返回时 ptr 也必须满足
+     */
+    void* reallocate(void* ptr, size_t new_size, size_t align = ALIGNMENT) {
+        if (!ptr) return allocate_impl(new_size, false, align);
+        if (!new_size) {
+            free(*this, ptr, 0);
+            return nullptr;
+        }
+        if (new_size > MAX_ALLOC_SIZE) throw std::bad_alloc{};
+
+        size_t old_size = 0;
+        if (const SlabMeta* meta = slab_meta_of(ptr)) [[likely]] {
+            old_size = meta->object_size;
+        } else {
+            Chunk* chunk = Chunk::from_data(ptr);
+            old_size = chunk->size;
+            if (void* resized = resize_chunk(chunk, new_size, align)) return resized;
+        }
+        const bool aligned = (reinterpret_cast<uintptr_t>(ptr) & (align - 1)) == 0;
+        if (new_size <= old_size && new_size > old_size / 2 && aligned) return ptr;
+
+        void* fresh = allocate_impl(new_size, false, align);
+        std::memcpy(fresh, ptr, new_size < old_size ? new_size : old_size);
+        free(*this, ptr, old_size);
+        return fresh;
+    }
+
+    /*
+     * @function: 一次分配 n 个 size 字节的对象写入 out, 仅允许 owner 线程调用
+     * @note: 可缓存的 class 直接从 fastbin 头部连续摘下一段, fastbin 不够时整批补充后继续, 不逐个走 allocate
+     * @note: 中途分配失败时已取得的对象全部释放, 再抛出 std::bad_alloc
+     */
+    void allocate_batch(size_t size, size_t n, void** out) {
+        if (size > MAX_CACHED_SIZE) [[unlikely]] {
+            size_t done = 0;
+            try {
+                for (; done < n; ++done) out[done] = allocate_impl(size, false);
+            } catch (...) {
+                free_batch(*this, out, done);
+                throw;
+            }
+            return;
+        }
+
+        const size_t idx = size_to_index(size);
+        size_t done = 0;
+        while (done < n) {
+            if (!fastbins[idx]) [[unlikely]] {
+                try {
+                    // note: 块 class 在缓存为空时只能逐个映射
+                    if (void* block = replenish(idx)) {
+                        out[done++] = block;
+                        continue;
+                    }
+                } catch (...) {
+                    free_batch(*this, out, done);
+                    throw;
+                }
+            }
+            FreeObject* object = fastbins[idx];
+            uint32_t taken = 0;
+            while (object && done < n) {
+                out[done++] = object;
+                object = object->next;
+                ++taken;
+            }
+            fastbins[idx] = object;
+            cache_count[idx] -= taken;
+        }
+    }
+
+    /*
+     * @function: 释放 n 个任意线程分配的对象, 等价于逐个调用 free, 但只取一次 Arena
+     * @note: 相邻的指针常常来自同一个 slab, 沿用上一个对象的 SlabMeta 时不必重新查表
+     * @note: 与 free 相同, 其他节点的 slab 对象与块压回所属节点
+     */
+    static void free_batch(Arena& local, void* const* ptrs, size_t n) {
+        const SlabMeta* meta = nullptr;
+        const char* slab_begin = nullptr;
+        const char* slab_end = nullptr;
+        for (size_t i = 0; i < n; ++i) {
+            void* ptr = ptrs[i];
+            if (!ptr) continue;
+            const char* addr = static_cast<const char*>(ptr);
+            if (addr < slab_begin || addr >= slab_end) {
+                meta = slab_meta_of(ptr);
+                if (meta) {
+                    slab_begin = reinterpret_cast<const char*>(meta);
+                    slab_end = slab_begin + slab_size_of(meta->size_class);
+                } else {
+                    slab_begin = slab_end = nullptr;
+                    Chunk* chunk = Chunk::from_data(ptr);
+                    if (chunk->size > MAX_CACHED_SIZE) {
+                        release_chunk(chunk);
+                    } else if (chunk->node != local.node) [[unlikely]] {
+                        node_inboxes[chunk->node].push(ptr);
+                    } else {
+                        local.push_local(size_to_index(chunk->size), ptr);
+                    }
+                    continue;
+                }
+            }
+            if (meta->node != local.node) [[unlikely]] {
+                node_inboxes[meta->node].push(ptr);
+            } else {
+                local.push_local(meta->size_class, ptr);
+            }
+        }
+    }
+
+    // @function: 释放 ptr 到本 Arena 的线程缓存, 仅允许 owner 线程调用
+    // @note: 与 free 一样, 其他节点的 slab 对象与块压入所属节点的 node_inboxes
+    void deallocate(void* ptr, size_t size) {
+        if (!ptr) return;
+
+        if (size > MAX_CACHED_SIZE) {
+            release_chunk(Chunk::from_data(ptr));
+            return;
+        }
+        // note: 小请求也可能落在块 class 上(超过一页的对齐), 没有 slab 登记的都按块处理
+        const SlabMeta* meta = size <= MAX_SMALL_SIZE ? slab_meta_of(ptr) : nullptr;
+        const Chunk* chunk = meta ? nullptr : Chunk::from_data(ptr);
+        const size_t home = meta ? meta->node : chunk->node;
+        if (home != node) [[unlikely]] {
+            node_inboxes[home].push(ptr);
+            return;
+        }
+        push_local(meta ? meta->size_class : size_to_index(chunk->size), ptr);
+    }
+
+    // @function: ptr 实际可用的字节数: 小对象为所在 class 的大小, 带头部的块为头部记录的大小
+    static size_t usable_size(void* ptr) noexcept {
+        if (!ptr) return 0;
+        if (const SlabMeta* meta = slab_meta_of(ptr)) [[likely]] return meta->object_size;
+        return Chunk::from_data(ptr)->size;
+    }
+
+    bool is_owner() const noexcept {
+        return owner == std::this_thread::get_id();
+    }
+
+    // @function: 释放任意线程分配的 ptr; 小对象查 slab_meta_of, 其余读 Chunk 头部
+    // @param: local 调用线程自己的 Arena
+    // @note: 对象放入调用线程自己的 fastbin, 超出上限后经 central_free_list 流向其他线程
+    // @note: 不退回分配它的 Arena, 否则该 Arena 的线程退出后这些对象会滞留在废弃的 Arena 中
+    // @note: 其他节点的 slab 对象与块压入所属节点的 node_inboxes, 不进入本线程缓存, 以免被本节点复用
+    static void free(Arena& local, void* ptr, size_t /*size*/) {
+        if (!ptr) return;
+        size_t idx = 0;
+        if (const SlabMeta* meta = slab_meta_of(ptr)) [[likely]] {
+            if (meta->node != local.node) [[unlikely]] {
+                node_inboxes[meta->node].push(ptr);
+                return;
+            }
+            idx = meta->size_class;
+        } else {
+            Chunk* chunk = Chunk::from_data(ptr);
+            if (chunk->size > MAX_CACHED_SIZE) {
+                release_chunk(chunk);
+                return;
+            }
+            if (chunk->node != local.node) [[unlikely]] {
+                node_inboxes[chunk->node].push(ptr);
+                return;
+            }
+            idx = size_to_index(chunk->size);
+        }
+        local.push_local(idx, ptr);
+    }
+
+    size_t node_id() const noexcept { return node; }
+
+    /*
+     * @function: 把本 Arena 改到 node 节点, 之后新切的 slab 和块绑定到该节点, 仅允许 owner 线程调用
+     * @note: node 不必在线, 单节点机器上可以用来模拟多个节点; 超过 MAX_NUMA_NODES 的节点号取模
+     * @note: 线程缓存中已有的对象先按原节点交还, 不会被新节点继续使用
+     */
+    void set_node(size_t new_node) {
+        flush_cache();
+        node = static_cast<uint16_t>(new_node % MAX_NUMA_NODES);
+        note_node_used(node);
+    }
+
+private:
+    friend class ArenaRegistry;
+    friend class Decay;
+
+    inline static std::atomic<size_t> next_shard{0};
+
+    std::thread::id owner;
+    Arena* next_abandoned = nullptr;
+    Arena* next_registered = nullptr; // comment: ArenaRegistry 中所有 Arena 串成的链表, 只增不减
+    size_t shard; // comment: 在 central_free_list 中优先使用的分片
+    uint16_t node; // comment: 所属的 NUMA 节点, 只由 owner 线程读写
+    std::array<FreeObject*, NUM_SIZE_CLASSES> fastbins{};
+    std::array<uint32_t, NUM_SIZE_CLASSES> cache_count{};
+
+    void* allocate_impl(size_t size, bool zero, size_t align = ALIGNMENT) {
         if (size > MAX_ALLOC_SIZE) throw std::bad_alloc{};
+        if (!std::has_single_bit(align)) throw std::bad_alloc{};
 
-        if (size <= MAX_FAST_SIZE) {
-            size_t idx = size_to_index(size);
-            if (fastbins[idx]) {
-                Chunk* chunk = fastbins[idx];
-                fastbins[idx] = chunk->next;
-                return chunk->data();
+        if (size <= MAX_CACHED_SIZE) [[likely]] {
+            size_t idx = 0;
+            if (align <= ALIGNMENT) [[likely]] {
+                idx = size_to_index(size);
+            } else if (align <= MAX_NATURAL_ALIGN) {
+                idx = aligned_size_to_index(size, align);
+            } else {
+                // note: 超过一页的对齐只能由单独映射的块满足, 小请求也落到最小的块 class
+                idx = size_to_index(size > MAX_SMALL_SIZE ? size : MAX_SMALL_SIZE + 1);
+            }
+            if (idx > MAX_SMALL_INDEX && align > BLOCK_ALIGN) [[unlikely]] {
+                // note: 缓存中的块只保证 BLOCK_ALIGN, 这里总是新映射, 已经是零页
+                return allocate_block(idx, align);
             }
+            return allocate_class(idx, size, zero);
         }
 
-        size_t total_size = align_up(size + sizeof(Chunk));
+        // note: 头部放在数据之前, 对齐超过底层分配的对齐时在头部前面填充
         void* raw = nullptr;
-
+        size_t total_size = 0;
         if (size >= MMAP_THRESHOLD) {
-            raw = os_alloc(total_size);
-            if (!raw) throw std::bad_alloc{};
+            total_size = size + Chunk::prefix(align);
+            // note: 新映射的内存已经是零, zero 请求不需要额外处理
+            // note: 先 madvise 再提交, 让 Prefault/Zero 提交的也是大页
+            const CommitPolicy policy = large_commit_policy.load(std::memory_order_relaxed);
+            raw = os_alloc(total_size, CommitPolicy::Lazy);
+            if (raw) {
+                os_advise_huge(raw, total_size);
+                os_bind_node(raw, total_size, node);
+                os_commit(raw, total_size, policy);
+            }
         } else {
-            raw = std::malloc(total_size);
-            if (!raw) throw std::bad_alloc{};
-            std::memset(raw, 0, total_size); // 强制触发页表分配
+            total_size = size + Chunk::prefix(align);
+            raw = zero ? std::calloc(1, total_size) : std::malloc(total_size);
         }
+        if (!raw) throw std::bad_alloc{};
+        if (size >= MMAP_THRESHOLD) return Chunk::place_mapped(raw, total_size, size, align, node);
+        return Chunk::place(raw, size, align);
+    }
 
-        Chunk* chunk = reinterpret_cast<Chunk*>(raw);
-        chunk->size = size;
-        return chunk->data();
+    // @function: 从 idx 号 class 的 fastbin 取出一个对象, fastbin 为空时由 replenish 补充
+    void* allocate_class(size_t idx, size_t size, bool zero) {
+        if (!fastbins[idx]) [[unlikely]] {
+            // note: 新映射的块已经是零页
+            if (void* block = replenish(idx)) return block;
+        }
+        FreeObject* object = fastbins[idx];
+        fastbins[idx] = object->next;
+        --cache_count[idx];
+        if (zero) std::memset(object, 0, size);
+        return object;
     }
 
-    void deallocate(void* ptr, size_t size) {
-        std::scoped_lock lock(mtx);
-        if (!ptr) return;
+    /*
+     * @function: 补充空的 idx 号 fastbin, 依次尝试本节点的 node_inboxes, 本节点的中心链表, 新 slab
+     * @note: 块 class 没有 slab 可切, 新映射的块直接返回给调用方, 其余情况返回 nullptr 且 fastbin 已非空
+     * @note: 向系统申请失败时按距离向其他节点的中心链表借, 都借不到才抛出 std::bad_alloc
+     */
+    void* replenish(size_t idx) {
+        if (!node_inboxes[node].empty()) drain_inbox();
+        if (fastbins[idx] || fetch_from_central(idx)) return nullptr;
+        if (idx > MAX_SMALL_INDEX) {
+            if (void* block = map_block(idx, BLOCK_ALIGN)) return block;
+        } else if (refill(idx)) {
+            return nullptr;
+        }
+        if (!borrow_from_nodes(idx)) throw std::bad_alloc{};
+        return nullptr;
+    }
 
-        Chunk* chunk = Chunk::from_data(ptr);
+    // @function: 按距离从近到远, 从其他节点的中心链表取一批对象放入空的 fastbin
+    bool borrow_from_nodes(size_t idx) {
+        const NumaTopology& topology = NumaTopology::instance();
+        for (size_t i = 1; i < MAX_NUMA_NODES; ++i) {
+            const size_t other = topology.nearest(node, i);
+            FreeBatch batch = central_free_lists[other].remove(idx, shard, batch_sizes[idx]);
+            if (!batch.count) continue;
+            fastbins[idx] = batch.head;
+            cache_count[idx] = static_cast<uint32_t>(batch.count);
+            return true;
+        }
+        return false;
+    }
 
-        if (size <= MAX_FAST_SIZE) {
-            size_t idx = size_to_index(size);
-            chunk->next = fastbins[idx];
-            fastbins[idx] = chunk;
+    // @function: 摘下本节点 node_inboxes 中其他节点的线程送回的对象, 按 size class 归还到 fastbin
+    void drain_inbox() {
+        FreeObject* object = node_inboxes[node].take_all();
+        while (object) {
+            FreeObject* next = object->next;
+            push_local(cached_class_of(object), object);
+            object = next;
+        }
+    }
+
+    void push_local(size_t idx, void* ptr) {
+        FreeObject* object = static_cast<FreeObject*>(ptr);
+        object->next = fastbins[idx];
+        fastbins[idx] = object;
+        if (++cache_count[idx] > cache_capacities[idx]) [[unlikely]] {
+            release_to_central(idx);
+        }
+    }
+
+    // @function: 从 fastbin 头部摘下一批对象交给 central_free_list
+    void release_to_central(size_t idx) {
+        FreeBatch batch;
+        batch.head = fastbins[idx];
+        batch.tail = batch.head;
+        batch.count = 1;
+        while (batch.count < batch_sizes[idx]) {
+            batch.tail = batch.tail->next;
+            ++batch.count;
+        }
+        fastbins[idx] = batch.tail->next;
+        cache_count[idx] -= static_cast<uint32_t>(batch.count);
+        central_free_lists[node].insert(idx, shard, batch);
+        decay_tick();
+    }
+
+    // @function: 从 central_free_list 取回一批对象放入空的 fastbin, 取不到返回 false
+    bool fetch_from_central(size_t idx) {
+        FreeBatch batch = central_free_lists[node].remove(idx, shard, batch_sizes[idx]);
+        if (!batch.count) return false;
+        fastbins[idx] = batch.head;
+        cache_count[idx] = static_cast<uint32_t>(batch.count);
+        return true;
+    }
+
+    // @function: 把所有 fastbin 整条交给 central_free_list, 线程退出时调用
+    void flush_cache() {
+        for (size_t idx = 0; idx < NUM_SIZE_CLASSES; ++idx) {
+            if (!fastbins[idx]) continue;
+            FreeBatch batch;
+            batch.head = fastbins[idx];
+            batch.tail = batch.head;
+            batch.count = cache_count[idx];
+            while (batch.tail->next) batch.tail = batch.tail->next;
+            central_free_lists[node].insert(idx, shard, batch);
+            fastbins[idx] = nullptr;
+            cache_count[idx] = 0;
+        }
+    }
+
+    // @function: 取一整块 slab, 切分成若干个同一 size class 的对象
+    // @note: 按地址从低到高串成链表, 连续分配得到的对象在内存上也是相邻的
+    // @note: 只有第一批留在空的 fastbin 中, 其余交给 central_free_list 供所有线程使用
+    // @note: 优先复用 retired_slabs 中同样大小的 slab, 它的登记仍然有效, 不需要重新登记
+    // @note: 新 slab 在首次写入前绑定到本节点; 复用其他节点退役的 slab 时连同仍驻留的首页一起迁移
+    // @note: 系统内存耗尽时返回 false, 由调用方决定是否向其他节点借
+    bool refill(size_t idx) {
+        decay_tick();
+        const size_t size = index_to_size(idx);
+        const size_t slab_size = slab_size_of(idx);
+        const size_t offset = slab_object_offset(size);
+        const size_t count = (slab_size - offset) / size;
+        const SlabMeta init{
+            static_cast<uint16_t>(idx), node, static_cast<uint32_t>(size),
+            static_cast<uint32_t>(count), 0, nullptr
+        };
+
+        char* slab = reinterpret_cast<char*>(retired_slabs.pop(slab_size));
+        if (slab) {
+            if (reinterpret_cast<SlabMeta*>(slab)->node != node) os_bind_node(slab, slab_size, node, true);
+            new (slab) SlabMeta{init};
         } else {
-            size_t total_size = align_up(size + sizeof(Chunk));
-            if (size >= MMAP_THRESHOLD) {
-                os_free(chunk, total_size);
+            // note: 通常只是在 slab_heap 中移动指针, 不发生系统调用
+            slab = static_cast<char*>(slab_heap.allocate(slab_size));
+            const bool in_heap = slab != nullptr;
+            if (!in_heap) slab = static_cast<char*>(os_alloc(slab_size));
+            if (!slab) return false;
+            os_bind_node(slab, slab_size, node);
+
+            SlabMeta* meta = new (slab) SlabMeta{init};
+            if (in_heap) {
+                slab_heap.set(slab, slab_size, meta);
             } else {
-                std::free(chunk);
+                page_map.set(slab, slab_size, meta);
             }
         }
+
+        auto object_at = [&](size_t i) {
+            return reinterpret_cast<FreeObject*>(slab + offset + i * size);
+        };
+        FreeObject* head = nullptr;
+        for (size_t i = count; i-- > 0;) {
+            FreeObject* object = object_at(i);
+            object->next = head;
+            head = object;
+        }
+
+        const size_t keep = count < batch_sizes[idx] ? count : batch_sizes[idx];
+        FreeObject* last = object_at(keep - 1);
+        central_free_lists[node].insert(idx, shard, {last->next, object_at(count - 1), count - keep});
+        last->next = nullptr;
+        fastbins[idx] = head;
+        cache_count[idx] = static_cast<uint32_t>(keep);
+        return true;
+    }
+
+    /*
+     * @function: 原地调整超过 MAX_CACHED_SIZE 的块, 新旧大小不在同一种分配方式内或调整失败时返回 nullptr
+     * @note: realloc 只保证 ALIGNMENT, 带填充的堆上块不交给它; mremap 只保持页内偏移, 不满足超过一页的对齐
+     */
+    static void* resize_chunk(Chunk* chunk, size_t new_size, size_t align) {
+        const size_t old_size = chunk->size;
+        if (old_size <= MAX_CACHED_SIZE || new_size <= MAX_CACHED_SIZE) return nullptr;
+        const bool mapped = old_size >= MMAP_THRESHOLD;
+        if (mapped != (new_size >= MMAP_THRESHOLD)) return nullptr;
+        if (reinterpret_cast<uintptr_t>(chunk->data()) & (align - 1)) return nullptr;
+        if (mapped ? align > OS_ALIGNMENT : (chunk->offset || align > ALIGNMENT)) return nullptr;
+
+        const size_t offset = chunk->offset;
+        const size_t old_total = chunk->total();
+        const size_t new_total = offset + sizeof(Chunk) + new_size;
+        void* raw = mapped ? os_remap(chunk->base(), old_total, new_total) : std::realloc(chunk, new_total);
+        if (!raw) return nullptr;
+        if (mapped && new_total > old_total) {
+            // note: 新增的部分同样按提交策略处理, 透明大页的建议随映射一起保留
+            os_commit(static_cast<char*>(raw) + old_total, new_total - old_total,
+                      large_commit_policy.load(std::memory_order_relaxed));
+        }
+        Chunk* resized = reinterpret_cast<Chunk*>(static_cast<char*>(raw) + offset);
+        resized->size = new_size;
+        return resized->data();
+    }
+
+    // @function: 为 16KB~4MB 的 class 单独映射一块带头部的内存, 数据按 align 对齐, 失败返回 nullptr
+    // @note: 超过一页的对齐多映射 align 字节, 放置头部后由 Chunk::place_mapped 解除首尾多余的页
+    // @note: 物理页在写入头部之前绑定到本节点, 头部记下节点号, 其他节点的线程释放时据此送回
+    void* map_block(size_t idx, size_t align) {
+        const size_t size = index_to_size(idx);
+        const size_t total_size = Chunk::prefix(align) + size;
+        void* raw = os_alloc(total_size);
+        if (!raw) return nullptr;
+        os_bind_node(raw, total_size, node);
+        return Chunk::place_mapped(raw, total_size, size, align, node);
+    }
+
+    void* allocate_block(size_t idx, size_t align) {
+        void* block = map_block(idx, align);
+        if (!block) throw std::bad_alloc{};
+        return block;
+    }
+
+    // @function: 把不参与缓存的块直接还给系统
+    static void release_chunk(Chunk* chunk) {
+        const size_t size = chunk->size;
+        if (size <= MAX_CACHED_SIZE || size >= MMAP_THRESHOLD) {
+            os_free(chunk->base(), chunk->total());
+        } else {
+            std::free(chunk->base());
+        }
+    }
+};
+
+// note: 线程退出时其 Arena 被标记为废弃(abandoned), 由之后新建的线程接管, 永不析构
+// note: 仍可能有 UnsynchronizedArenaResource 之类的句柄指向它, 复用比析构更安全
+class ArenaRegistry {
+public:
+    static ArenaRegistry& instance() {
+        static ArenaRegistry registry;
+        return registry;
+    }
+
+    // @function: 优先接管调用线程所在 NUMA 节点上一个废弃的 Arena, 没有则在该节点新建
+    // @note: 不接管其他节点的 Arena, 它的 slab 绑定在原节点上
+    Arena* acquire() {
+        const size_t node = numa_current_node();
+        Arena* arena = nullptr;
+        {
+            std::scoped_lock lock(mtx);
+            arena = abandoned[node];
+            if (arena) abandoned[node] = arena->next_abandoned;
+        }
+        if (!arena) {
+            // note: 不经过 operator new, 替换全局 operator new / malloc 后也不会递归回到这里
+            void* storage = os_alloc(sizeof(Arena));
+            if (!storage) throw std::bad_alloc{};
+            os_bind_node(storage, sizeof(Arena), node);
+            arena = new (storage) Arena(node);
+            std::scoped_lock lock(mtx);
+            arena->next_registered = registered;
+            registered = arena;
+            return arena;
+        }
+
+        arena->owner = std::this_thread::get_id();
+        arena->next_abandoned = nullptr;
+        return arena;
+    }
+
+    // @function: 线程退出, 放弃对 arena 的所有权
+    // @note: 缓存的对象先全部交给 central_free_list, 废弃的 Arena 不占用空闲内存
+    void release(Arena* arena) {
+        arena->flush_cache();
+        std::scoped_lock lock(mtx);
+        arena->owner = std::thread::id{};
+        arena->next_abandoned = abandoned[arena->node];
+        abandoned[arena->node] = arena;
+    }
+
+    void fork_lock() { mtx.lock(); }
+    void fork_unlock() { mtx.unlock(); }
+
+    /*
+     * @function: fork 之后在子进程中调用, 子进程只剩下调用 fork 的线程, 其余线程的 Arena 全部标记为废弃
+     * @note: 这些线程可能停在 fastbin 操作的中途, 缓存的对象不可信, 直接丢弃(泄漏), 不交给中心链表
+     * @note: 清空后的 Arena 与新建的一样, 之后由子进程中新建的线程接管
+     */
+    void reset_after_fork() {
+        std::scoped_lock lock(mtx);
+        const std::thread::id self = std::this_thread::get_id();
+        for (Arena* arena = registered; arena; arena = arena->next_registered) {
+            if (arena->owner == std::thread::id{} || arena->owner == self) continue;
+            arena->fastbins.fill(nullptr);
+            arena->cache_count.fill(0);
+            arena->owner = std::thread::id{};
+            arena->next_abandoned = abandoned[arena->node];
+            abandoned[arena->node] = arena;
+        }
     }
 
 private:
+    ArenaRegistry() = default;
+
     std::mutex mtx;
-    std::array<Chunk*, NUM_FAST_BINS> fastbins{};
+    Arena* registered = nullptr;
+    std::array<Arena*, MAX_NUMA_NODES> abandoned{}; // comment: 按 Arena 所属的节点分开
+};
+
+/*
+ * @function: 基于时间的衰减, 把一段时间内没有被用到的空闲内存还给系统
+ * @note: 每隔 interval 执行一轮; 中心链表中自上一轮以来从未被取走的对象视为空闲(见 take_idle)
+ * @note: 空闲的大块(> MAX_SMALL_SIZE)直接解除映射; 小对象只有整个 slab 都空闲时, 才归还 slab 首页之外的物理页
+ * @note: 因此内存在空闲 interval ~ 2 * interval 之后归还; 线程缓存有上限, 不参与衰减
+ * @note: 默认在分配器的慢路径上顺带执行; 启动后台线程后改由后台线程执行
+ */
+class Decay {
+public:
+    static Decay& instance() {
+        static Decay decay;
+        return decay;
+    }
+
+    ~Decay() { stop_thread(); }
+
+    // @function: 设置衰减间隔, 0 表示关闭衰减
+    void set_interval(std::chrono::milliseconds interval) noexcept {
+        interval_ms.store(interval.count(), std::memory_order_relaxed);
+        cv.notify_all();
+    }
+
+    std::chrono::milliseconds interval() const noexcept {
+        return std::chrono::milliseconds(interval_ms.load(std::memory_order_relaxed));
+    }
+
+    // @function: 归还时使用 MADV_FREE(lazy = true) 还是 MADV_DONTNEED(默认)
+    void set_lazy_purge(bool lazy) noexcept {
+        lazy_purge.store(lazy, std::memory_order_relaxed);
+    }
+
+    /*
+     * @function: 立即执行一轮衰减, 返回归还给系统的字节数
+     * @param: all 为 true 时不看空闲时长, 中心链表中的全部内存都参与归还(类似 malloc_trim)
+     */
+    size_t purge(bool all = false) {
+        std::scoped_lock lock(purge_mtx);
+        return purge_locked(all);
+    }
+
+    // @function: 距离上一轮超过间隔时执行一轮; 已有线程在执行或后台线程在运行时直接返回
+    // @note: 拿到锁之后再检查一次间隔, 刚结束的一轮不会被紧接着重复执行
+    void tick() noexcept {
+        const int64_t interval = interval_ms.load(std::memory_order_relaxed);
+        if (interval <= 0 || background.load(std::memory_order_relaxed)) return;
+        if (now_ms() - last_purge.load(std::memory_order_relaxed) < interval) return;
+        std::unique_lock lock(purge_mtx, std::try_to_lock);
+        if (!lock.owns_lock()) return;
+        if (now_ms() - last_purge.load(std::memory_order_relaxed) < interval) return;
+        purge_locked(false);
+    }
+
+    // @function: 启动后台衰减线程, 已经在运行时返回 false
+    bool start_thread() {
+        std::scoped_lock lock(thread_mtx);
+        if (worker.joinable()) return false;
+        stopping = false;
+        background.store(true, std::memory_order_relaxed);
+        worker = std::thread([this] { run(); });
+        return true;
+    }
+
+    void stop_thread() {
+        {
+            std::scoped_lock lock(thread_mtx);
+            if (!worker.joinable()) return;
+            stopping = true;
+        }
+        cv.notify_all();
+        worker.join();
+        background.store(false, std::memory_order_relaxed);
+    }
+
+    // note: 先 thread_mtx 后 purge_mtx, 与后台线程的顺序一致(它不会同时持有两者)
+    void fork_lock() {
+        thread_mtx.lock();
+        purge_mtx.lock();
+    }
+
+    void fork_unlock() {
+        purge_mtx.unlock();
+        thread_mtx.unlock();
+    }
+
+    // @function: 子进程中没有后台线程, 丢弃它的句柄和条件变量, 恢复为在慢路径上衰减
+    void reset_after_fork() {
+        new (&worker) std::thread();
+        new (&cv) std::condition_variable();
+        stopping = false;
+        background.store(false, std::memory_order_relaxed);
+        fork_unlock();
+    }
+
+private:
+    Decay() : last_purge(now_ms()) {}
+
+    std::atomic<int64_t> interval_ms{10'000};
+    std::atomic<int64_t> last_purge;
+    std::atomic<bool> lazy_purge{false};
+    std::atomic<bool> background{false};
+    std::mutex purge_mtx;
+
+    std::mutex thread_mtx;
+    std::condition_variable cv;
+    std::thread worker;
+    bool stopping = false;
+
+    // @note: 调用方持有 purge_mtx
+    size_t purge_locked(bool all) {
+        last_purge.store(now_ms(), std::memory_order_relaxed);
+        drain_inboxes();
+        size_t bytes = 0;
+        for (size_t idx = 0; idx < NUM_SIZE_CLASSES; ++idx) {
+            bytes += idx > MAX_SMALL_INDEX ? purge_blocks(idx, all) : purge_slabs(idx, all);
+        }
+        // note: 间隔从本轮结束时算起, 链表很长时遍历本身也不会占满间隔
+        last_purge.store(now_ms(), std::memory_order_relaxed);
+        return bytes;
+    }
+
+    static int64_t now_ms() noexcept {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void run() {
+        std::unique_lock lock(thread_mtx);
+        while (!stopping) {
+            const int64_t interval = interval_ms.load(std::memory_order_relaxed);
+            // note: 衰减关闭时也定期醒来, 以便重新设置间隔后恢复工作
+            cv.wait_for(lock, std::chrono::milliseconds(interval > 0 ? interval : 1000));
+            if (stopping || interval_ms.load(std::memory_order_relaxed) <= 0) continue;
+            lock.unlock();
+            purge();
+            lock.lock();
+        }
+    }
+
+    // note: 所有中心链表的分片, 按 (节点, 分片) 展开; 只遍历用到过的节点
+    static constexpr size_t ALL_SHARDS = MAX_NUMA_NODES * CENTRAL_SHARDS;
+
+    static size_t used_slots() noexcept {
+        return node_limit.load(std::memory_order_relaxed) * CENTRAL_SHARDS;
+    }
+
+    static FreeBatch take_idle(size_t idx, size_t slot, bool all) {
+        return central_free_lists[slot / CENTRAL_SHARDS].take_idle(idx, slot % CENTRAL_SHARDS, all);
+    }
+
+    /*
+     * @function: 把 node_inboxes 中等待所属节点取走的对象放入该节点的中心链表
+     * @note: 节点上可能已经没有线程在分配, 不转入中心链表的话这些对象既不能复用也不能归还
+     */
+    static void drain_inboxes() {
+        const size_t nodes = node_limit.load(std::memory_order_relaxed);
+        for (size_t node = 0; node < nodes; ++node) {
+            if (node_inboxes[node].empty()) continue;
+            std::array<FreeBatch, NUM_SIZE_CLASSES> batches{};
+            FreeObject* object = node_inboxes[node].take_all();
+            while (object) {
+                FreeObject* next = object->next;
+                FreeBatch& batch = batches[cached_class_of(object)];
+                object->next = batch.head;
+                if (!batch.head) batch.tail = object;
+                batch.head = object;
+                ++batch.count;
+                object = next;
+            }
+            for (size_t idx = 0; idx < NUM_SIZE_CLASSES; ++idx) {
+                central_free_lists[node].insert(idx, 0, batches[idx]);
+            }
+        }
+    }
+
+    // @function: 空闲的大块不再缓存, 直接解除映射
+    size_t purge_blocks(size_t idx, bool all) {
+        size_t bytes = 0;
+        const size_t slots = used_slots();
+        for (size_t slot = 0; slot < slots; ++slot) {
+            FreeBatch batch = take_idle(idx, slot, all);
+            for (FreeObject* object = batch.head; batch.count--; ) {
+                FreeObject* next = object->next;
+                Chunk* chunk = Chunk::from_data(object);
+                bytes += chunk->total();
+                Arena::release_chunk(chunk);
+                object = next;
+            }
+        }
+        return bytes;
+    }
+
+    /*
+     * @function: 找出所有对象都空闲的 slab, 归还其首页之外的物理页并放入 retired_slabs
+     * @note: 先按 slab 计数, 计数等于 object_count 说明没有任何对象在线程缓存中或正被使用
+     * @note: 其余对象接回原分片的尾部, 下一轮仍算作空闲
+     * @note: 链表会穿过待归还的 slab, 必须全部遍历完之后再归还物理页
+     * @note: 借出的对象可能让同一个 slab 的空闲对象分散在几个节点的链表中, 因此所有节点一起计数
+     */
+    size_t purge_slabs(size_t idx, bool all) {
+        std::array<FreeBatch, ALL_SHARDS> batches;
+        const size_t slots = used_slots();
+        bool any = false;
+        for (size_t slot = 0; slot < slots; ++slot) {
+            batches[slot] = take_idle(idx, slot, all);
+            any |= batches[slot].count != 0;
+        }
+        if (!any) return 0;
+
+        auto for_each = [](FreeBatch& batch, auto&& fn) {
+            FreeObject* object = batch.head;
+            for (size_t i = 0; i < batch.count; ++i) {
+                FreeObject* next = object->next;
+                fn(object);
+                object = next;
+            }
+        };
+        for (size_t slot = 0; slot < slots; ++slot) {
+            for_each(batches[slot], [](FreeObject* object) { ++slab_meta_of(object)->scan_free; });
+        }
+
+        const size_t slab_size = slab_size_of(idx);
+        const size_t page = PageMap<SlabMeta>::PAGE_BYTES;
+        SlabMeta* retired = nullptr;
+        for (size_t slot = 0; slot < slots; ++slot) {
+            FreeBatch kept;
+            for_each(batches[slot], [&](FreeObject* object) {
+                SlabMeta* meta = slab_meta_of(object);
+                if (meta->scan_free == meta->object_count) {
+                    // note: 遇到该 slab 的第一个对象时记下整块; 用 UINT32_MAX 标记, 其余对象直接丢弃
+                    meta->scan_free = UINT32_MAX;
+                    meta->next_retired = retired;
+                    retired = meta;
+                } else if (meta->scan_free != UINT32_MAX) {
+                    object->next = kept.head;
+                    if (!kept.head) kept.tail = object;
+                    kept.head = object;
+                    ++kept.count;
+                }
+            });
+            for_each(kept, [](FreeObject* object) { slab_meta_of(object)->scan_free = 0; });
+            central_free_lists[slot / CENTRAL_SHARDS].append_idle(idx, slot % CENTRAL_SHARDS, kept);
+        }
 
-    static size_t size_to_index(size_t size) {
-        return (align_up(size) / ALIGNMENT) - 1;
+        const bool lazy = lazy_purge.load(std::memory_order_relaxed);
+        size_t bytes = 0;
+        while (retired) {
+            SlabMeta* next = retired->next_retired;
+            os_purge(reinterpret_cast<char*>(retired) + page, slab_size - page, lazy);
+            retired_slabs.push(retired, slab_size);
+            bytes += slab_size - page;
+            retired = next;
+        }
+        return bytes;
     }
 };
 
-inline thread_local Arena tls_arena;
+inline void decay_tick() noexcept {
+    Decay::instance().tick();
+}
+
+// @function: 设置衰减间隔, 0 表示关闭; 默认 10 秒
+inline void set_decay_interval(std::chrono::milliseconds interval) noexcept {
+    Decay::instance().set_interval(interval);
+}
+
+// @function: 立即把中心链表中的空闲内存全部还给系统, 返回归还的字节数
+inline size_t release_free_memory() {
+    return Decay::instance().purge(true);
+}
+
+/*
+ * @function: fork 的 prepare / parent / child 处理函数, 由替换 malloc 的一方用 pthread_atfork 注册
+ * @note: prepare 按固定顺序持有全部分配器锁: Decay, ArenaRegistry, 各节点的中心链表, retired_slabs, slab_heap, page_map
+ * @note: 否则 fork 时其他线程持有的锁在子进程中永远不会释放, 子进程第一次分配就会死锁
+ * @note: 这些锁之间没有嵌套(Decay 持有 purge_mtx 时才会去拿其余的锁), 按这个顺序加锁不会与分配路径形成环
+ */
+inline void prepare_fork() {
+    Decay::instance().fork_lock();
+    ArenaRegistry::instance().fork_lock();
+    for (auto& list : central_free_lists) list.fork_lock();
+    retired_slabs.fork_lock();
+    slab_heap.fork_lock();
+    page_map.fork_lock();
+}
+
+inline void after_fork_parent() {
+    page_map.fork_unlock();
+    slab_heap.fork_unlock();
+    retired_slabs.fork_unlock();
+    for (auto& list : central_free_lists) list.fork_unlock();
+    ArenaRegistry::instance().fork_unlock();
+    Decay::instance().fork_unlock();
+}
+
+// @note: 子进程中只有调用 fork 的线程, 它持有这些锁, 可以直接释放; 其余线程的 Arena 随后重置
+inline void after_fork_child() {
+    page_map.fork_unlock();
+    slab_heap.fork_unlock();
+    retired_slabs.fork_unlock();
+    for (auto& list : central_free_lists) list.fork_unlock();
+    ArenaRegistry::instance().fork_unlock();
+    Decay::instance().reset_after_fork();
+    ArenaRegistry::instance().reset_after_fork();
+}
+
+// note: 线程私有的 Arena 句柄, 构造时向 ArenaRegistry 申请, 线程退出时归还
+class ThreadArena {
+public:
+    ThreadArena() : arena(ArenaRegistry::instance().acquire()) {}
+    ~ThreadArena() { ArenaRegistry::instance().release(arena); }
+
+    ThreadArena(const ThreadArena&) = delete;
+    ThreadArena& operator=(const ThreadArena&) = delete;
+
+    Arena* operator->() const noexcept { return arena; }
+    Arena& operator*() const noexcept { return *arena; }
+
+private:
+    Arena* arena;
+};
+
+inline thread_local ThreadArena tls_arena;
+
+// @function: 在调用线程的 Arena 上一次分配 n 个 size 字节的对象, 按 ALIGNMENT 对齐
+inline void allocate_batch(size_t size, size_t n, void** out) {
+    tls_arena->allocate_batch(size, n, out);
+}
+
+// @function: 释放 n 个对象, 可以来自任意线程, 空指针被跳过
+inline void free_batch(void* const* ptrs, size_t n) {
+    Arena::free_batch(*tls_arena, ptrs, n);
+}
+
+// @function: 把调用线程的 Arena 改到 node 节点, 默认是线程第一次分配时所在 CPU 的节点
+inline void set_thread_node(size_t node) {
+    tls_arena->set_node(node);
+}
 
 template <typename T>
 class SAllocator {
@@ -137,12 +1224,31 @@ public:
     template <typename U>
     SAllocator(const SAllocator<U>&) noexcept {}
 
+    // note: alignof(T) 超过 ALIGNMENT 时走对齐分配, 在编译期选定
     T* allocate(std::size_t n) {
-        return static_cast<T*>(tls_arena.allocate(n * sizeof(T)));
+        if constexpr (alignof(T) > ALIGNMENT) {
+            return static_cast<T*>(tls_arena->allocate_aligned(n * sizeof(T), alignof(T)));
+        } else {
+            return static_cast<T*>(tls_arena->allocate(n * sizeof(T)));
+        }
+    }
+
+    // @function: calloc 语义的分配, 返回的内存全零
+    T* allocate_zeroed(std::size_t n) {
+        if constexpr (alignof(T) > ALIGNMENT) {
+            return static_cast<T*>(tls_arena->allocate_aligned_zeroed(n * sizeof(T), alignof(T)));
+        } else {
+            return static_cast<T*>(tls_arena->allocate_zeroed(n * sizeof(T)));
+        }
     }
 
     void deallocate(T* p, std::size_t n) {
-        tls_arena.deallocate(p, n * sizeof(T));
+        Arena::free(*tls_arena, p, n * sizeof(T));
+    }
+
+    // @function: realloc 语义, 内容按字节搬运, 只适用于可平凡复制的 T
+    T* reallocate(T* p, std::size_t n) {
+        return static_cast<T*>(tls_arena->reallocate(p, n * sizeof(T), alignof(T) > ALIGNMENT ? alignof(T) : ALIGNMENT));
     }
 };
 
@@ -152,4 +1258,116 @@ bool operator==(const SAllocator<T>&, const SAllocator<U>&) noexcept { return tr
 template <typename T, typename U>
 bool operator!=(const SAllocator<T>&, const SAllocator<U>&) noexcept { return false; }
 
-} 
\ No newline at end of file
+/*
+ * @function: std::pmr::memory_resource 形式的 Arena, 不需要改动模板参数就能让 std::pmr 容器走 Arena 的快速路径
+ * @note: 两种资源分配的内存都由 Arena::free 释放, 可以互相释放, 因此 is_equal 对两者都返回 true
+ */
+class ArenaResourceBase : public std::pmr::memory_resource {
+protected:
+    static void* allocate_from(Arena& arena, size_t bytes, size_t alignment) {
+        if (alignment > ALIGNMENT) [[unlikely]] return arena.allocate_aligned(bytes, alignment);
+        return arena.allocate(bytes);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return dynamic_cast<const ArenaResourceBase*>(&other) != nullptr;
+    }
+};
+
+/*
+ * @function: 绑定到构造线程的 Arena, 每次调用不再查线程局部变量, 对应 std::pmr::unsynchronized_pool_resource
+ * @note: 只能在构造它的线程上分配和释放, 且不能比该线程活得更久; 其他线程分配的内存也可以交给它释放
+ */
+class UnsynchronizedArenaResource : public ArenaResourceBase {
+public:
+    UnsynchronizedArenaResource() noexcept : arena(&*tls_arena) {}
+
+    Arena& owner() const noexcept { return *arena; }
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        assert(arena->is_owner() && "UnsynchronizedArenaResource used from a foreign thread");
+        return allocate_from(*arena, bytes, alignment);
+    }
+
+    void do_deallocate(void* ptr, size_t /*bytes*/, size_t /*alignment*/) override {
+        Arena::free(*arena, ptr, 0);
+    }
+
+private:
+    Arena* arena;
+};
+
+/*
+ * @function: 任意线程都可以使用的资源, 每次调用使用调用线程自己的 Arena, 对应 std::pmr::synchronized_pool_resource
+ * @note: 没有状态, 也不加锁: 线程之间的同步由 Arena::free 与 central_free_list 完成
+ */
+class SynchronizedArenaResource : public ArenaResourceBase {
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        return allocate_from(*tls_arena, bytes, alignment);
+    }
+
+    void do_deallocate(void* ptr, size_t /*bytes*/, size_t /*alignment*/) override {
+        Arena::free(*tls_arena, ptr, 0);
+    }
+};
+
+// @function: 进程内共享的 SynchronizedArenaResource, 用法同 std::pmr::new_delete_resource()
+inline std::pmr::memory_resource* arena_resource() noexcept {
+    static SynchronizedArenaResource resource;
+    return &resource;
+}
+
+} 
+
+/*
+ * @function: C++17 带 std::align_val_t 的全局 operator new / delete, 经由 Arena::allocate_aligned 分配
+ * @note: 全局运算符只能有一份定义: 在恰好一个翻译单元中先定义 SALLOCATOR_ALIGNED_NEW 再包含本头文件
+ * @note: 只替换对齐版本, 它们总是成对调用, 不会释放其他分配器分配的内存
+ */
+#ifdef SALLOCATOR_ALIGNED_NEW
+void* operator new(std::size_t size, std::align_val_t align) {
+    return Stellatus::tls_arena->allocate_aligned(size, static_cast<std::size_t>(align));
+}
+
+void* operator new[](std::size_t size, std::align_val_t align) {
+    return Stellatus::tls_arena->allocate_aligned(size, static_cast<std::size_t>(align));
+}
+
+void* operator new(std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    try {
+        return Stellatus::tls_arena->allocate_aligned(size, static_cast<std::size_t>(align));
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t& tag) noexcept {
+    return operator new(size, align, tag);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    Stellatus::Arena::free(*Stellatus::tls_arena, ptr, 0);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+    Stellatus::Arena::free(*Stellatus::tls_arena, ptr, 0);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {
+    Stellatus::Arena::free(*Stellatus::tls_arena, ptr, 0);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept {
+    Stellatus::Arena::free(*Stellatus::tls_arena, ptr, 0);
+}
+
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept {
+    Stellatus::Arena::free(*Stellatus::tls_arena, ptr, 0);
+}
+
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept {
+    Stellatus::Arena::free(*Stellatus::tls_arena, ptr, 0);
+}
+#endif
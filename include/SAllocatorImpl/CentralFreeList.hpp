@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cstddef>
+#include <array>
+#include <atomic>
+#include <mutex>
+
+namespace Stellatus {
+
+// note: 空闲的对象首个字长复用为链表指针
+struct FreeObject {
+    FreeObject* next;
+};
+
+// note: 一串首尾相连的空闲对象, 在线程缓存与中心链表之间整体搬运
+struct FreeBatch {
+    FreeObject* head = nullptr;
+    FreeObject* tail = nullptr;
+    size_t count = 0;
+};
+
+/*
+ * @function: 无锁的空闲对象栈, 任意线程 push, 消费方用 take_all 一次摘下整条链表
+ * @note: 不支持单个 pop, 因此没有 ABA 问题; 链表中可以混有不同 size class 的对象
+ */
+class FreeStack {
+public:
+    void push(void* ptr) noexcept {
+        FreeObject* object = static_cast<FreeObject*>(ptr);
+        FreeObject* old = head.load(std::memory_order_relaxed);
+        do {
+            object->next = old;
+        } while (!head.compare_exchange_weak(
+            old, object,
+            std::memory_order_release,
+            std::memory_order_relaxed
+        ));
+    }
+
+    FreeObject* take_all() noexcept {
+        return head.exchange(nullptr, std::memory_order_acquire);
+    }
+
+    bool empty() const noexcept {
+        return !head.load(std::memory_order_relaxed);
+    }
+
+private:
+    // note: 独占一条 cache line, 不同节点的栈之间不发生伪共享
+    alignas(64) std::atomic<FreeObject*> head{nullptr};
+};
+
+/*
+ * @function: 所有线程共享的中心空闲链表, 每个 size class 拆成 NumShards 个分片各自持锁
+ * @note: 线程缓存溢出时整批放入自己的分片; 缺货时先取自己的分片, 再依次从其他分片搬运
+ * @note: 这样空闲线程归还的内存可以被繁忙线程取走
+ * @note: 对象总是从头部进出, 每个分片记录上一次 take_idle 以来长度的最低值 low_water,
+ * @note: 链表尾部的 low_water 个对象在这段时间内从未被取走, 即为空闲对象
+ */
+template <size_t NumClasses, size_t NumShards>
+class CentralFreeList {
+public:
+    // @function: 把一整批对象放入 idx 号 class 的 shard 分片
+    void insert(size_t idx, size_t shard, FreeBatch batch) {
+        if (!batch.count) return;
+        Shard& s = shards[idx][shard % NumShards];
+        std::scoped_lock lock(s.mtx);
+        batch.tail->next = s.head;
+        if (!s.head) s.tail = batch.tail;
+        s.head = batch.head;
+        s.length.fetch_add(batch.count, std::memory_order_relaxed);
+    }
+
+    // @function: 把一批空闲对象接回 shard 分片的尾部, 它们在下一次 take_idle 时仍算作空闲
+    void append_idle(size_t idx, size_t shard, FreeBatch batch) {
+        if (!batch.count) return;
+        Shard& s = shards[idx][shard % NumShards];
+        std::scoped_lock lock(s.mtx);
+        batch.tail->next = nullptr;
+        if (s.tail) {
+            s.tail->next = batch.head;
+        } else {
+            s.head = batch.head;
+        }
+        s.tail = batch.tail;
+        s.length.fetch_add(batch.count, std::memory_order_relaxed);
+        s.low_water += batch.count;
+    }
+
+    /*
+     * @function: 摘下 shard 分片尾部自上次调用以来从未被取走的对象
+     * @param: all 为 true 时不看 low_water, 摘下整条链表
+     * @note: 需要走到截断位置, 代价与链表长度成正比, 只应在衰减线程或慢路径上调用
+     */
+    FreeBatch take_idle(size_t idx, size_t shard, bool all = false) {
+        Shard& s = shards[idx][shard % NumShards];
+        std::scoped_lock lock(s.mtx);
+        const size_t length = s.length.load(std::memory_order_relaxed);
+        const size_t idle = all ? length : s.low_water;
+        if (!idle) {
+            s.low_water = length;
+            return {};
+        }
+
+        FreeBatch batch;
+        batch.tail = s.tail;
+        batch.count = idle;
+        if (idle == length) {
+            batch.head = s.head;
+            s.head = nullptr;
+            s.tail = nullptr;
+        } else {
+            FreeObject* cut = s.head;
+            for (size_t i = 1; i < length - idle; ++i) cut = cut->next;
+            batch.head = cut->next;
+            cut->next = nullptr;
+            s.tail = cut;
+        }
+        s.length.store(length - idle, std::memory_order_relaxed);
+        s.low_water = length - idle;
+        return batch;
+    }
+
+    // @function: 取出至多 max 个 idx 号 class 的对象, 优先从 shard 分片取
+    FreeBatch remove(size_t idx, size_t shard, size_t max) {
+        for (size_t i = 0; i < NumShards; ++i) {
+            Shard& s = shards[idx][(shard + i) % NumShards];
+            // note: 不加锁的预判, 避免在空分片上争抢锁
+            if (!s.length.load(std::memory_order_relaxed)) continue;
+            std::scoped_lock lock(s.mtx);
+            if (!s.head) continue;
+
+            FreeBatch batch;
+            batch.head = s.head;
+            batch.tail = s.head;
+            batch.count = 1;
+            while (batch.count < max && batch.tail->next) {
+                batch.tail = batch.tail->next;
+                ++batch.count;
+            }
+            s.head = batch.tail->next;
+            if (!s.head) s.tail = nullptr;
+            const size_t left = s.length.load(std::memory_order_relaxed) - batch.count;
+            s.length.store(left, std::memory_order_relaxed);
+            if (left < s.low_water) s.low_water = left;
+            batch.tail->next = nullptr;
+            return batch;
+        }
+        return {};
+    }
+
+    // @function: fork 前按 (class, 分片) 的固定顺序持有全部分片的锁, 之后在父子进程中各自释放
+    void fork_lock() {
+        for (auto& row : shards) {
+            for (Shard& s : row) s.mtx.lock();
+        }
+    }
+
+    void fork_unlock() {
+        for (auto& row : shards) {
+            for (Shard& s : row) s.mtx.unlock();
+        }
+    }
+
+    // @function: idx 号 class 在所有分片中的对象总数, 仅用于统计
+    size_t length(size_t idx) const {
+        size_t total = 0;
+        for (const Shard& s : shards[idx]) {
+            total += s.length.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+private:
+    struct alignas(64) Shard {
+        std::mutex mtx;
+        FreeObject* head = nullptr;
+        FreeObject* tail = nullptr;
+        std::atomic<size_t> length{0};  // comment: 只在持锁时修改
+        size_t low_water = 0;           // comment: 上次 take_idle 以来 length 的最低值
+    };
+
+    std::array<std::array<Shard, NumShards>, NumClasses> shards{};
+};
+
+}
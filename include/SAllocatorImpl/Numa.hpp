@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+namespace Stellatus {
+
+constexpr size_t MAX_NUMA_NODES = 8; // 支持的 NUMA 节点数上限, 更大的节点号按取模折叠
+
+/*
+ * @function: 系统的 NUMA 拓扑: 在线节点数, 以及每个节点按距离从近到远排好的所有节点
+ * @note: 从 /sys/devices/system/node 读取, 只用 open/read, 不分配内存, 替换 malloc 后也能调用
+ * @note: 读不到时(非 Linux, 容器中没有 sysfs)视为单节点
+ * @note: 不在线的节点号(包括 set_node 模拟的节点)排在所有在线节点之后, 它们没有内存, 不应先于真正的远端节点
+ */
+class NumaTopology {
+public:
+    static const NumaTopology& instance() {
+        static const NumaTopology topology;
+        return topology;
+    }
+
+    size_t node_count() const noexcept { return count; }
+
+    // @function: 离 node 第 i 近的节点, i 取 [0, MAX_NUMA_NODES), i = 0 时是 node 本身
+    size_t nearest(size_t node, size_t i) const noexcept {
+        return order[node % MAX_NUMA_NODES][i];
+    }
+
+private:
+    size_t count = 1;
+    uint32_t online = 1; // comment: 在线节点的位图
+    std::array<std::array<uint8_t, MAX_NUMA_NODES>, MAX_NUMA_NODES> order{};
+
+    NumaTopology() {
+        // note: 与内核的默认值一致, 本节点 10, 其他节点 20
+        std::array<std::array<int, MAX_NUMA_NODES>, MAX_NUMA_NODES> distance{};
+        for (size_t from = 0; from < MAX_NUMA_NODES; ++from) {
+            for (size_t to = 0; to < MAX_NUMA_NODES; ++to) distance[from][to] = from == to ? 10 : 20;
+        }
+        detect(distance);
+
+        // note: 按 (本节点, 在线, 距离, 节点号) 插入排序, 距离相同的节点保持编号顺序
+        for (size_t from = 0; from < MAX_NUMA_NODES; ++from) {
+            auto rank = [&](size_t to) {
+                if (to == from) return 0;
+                return (online >> to & 1u) ? distance[from][to] : distance[from][to] + (1 << 16);
+            };
+            auto& row = order[from];
+            for (size_t i = 0; i < MAX_NUMA_NODES; ++i) {
+                size_t j = i;
+                while (j > 0 && rank(row[j - 1]) > rank(i)) {
+                    row[j] = row[j - 1];
+                    --j;
+                }
+                row[j] = static_cast<uint8_t>(i);
+            }
+        }
+    }
+
+    void detect(std::array<std::array<int, MAX_NUMA_NODES>, MAX_NUMA_NODES>& distance) {
+#if defined(__linux__)
+        char buf[256];
+        // note: 形如 "0-1" 或 "0,2-3"; 节点号上限取最大的在线节点, 中间可能有不在线的空洞
+        size_t len = read_file("/sys/devices/system/node/online", buf, sizeof(buf));
+        uint32_t mask = 0;
+        size_t highest = 0;
+        size_t range_begin = 0;
+        bool in_range = false;
+        for (size_t i = 0; i < len;) {
+            if (buf[i] == '-') in_range = true;
+            if (buf[i] < '0' || buf[i] > '9') {
+                ++i;
+                continue;
+            }
+            size_t id = 0;
+            while (i < len && buf[i] >= '0' && buf[i] <= '9') id = id * 10 + static_cast<size_t>(buf[i++] - '0');
+            for (size_t n = in_range ? range_begin : id; n <= id && n < MAX_NUMA_NODES; ++n) mask |= 1u << n;
+            if (id > highest) highest = id;
+            range_begin = id;
+            in_range = false;
+        }
+        if (!mask) return;
+        online = mask;
+        count = highest + 1 < MAX_NUMA_NODES ? highest + 1 : MAX_NUMA_NODES;
+
+        char path[] = "/sys/devices/system/node/node0/distance";
+        constexpr size_t digit = sizeof("/sys/devices/system/node/node") - 1;
+        for (size_t from = 0; from < count; ++from) {
+            if (!(online >> from & 1u)) continue;
+            path[digit] = static_cast<char>('0' + from);
+            len = read_file(path, buf, sizeof(buf));
+            // note: 文件中只列出在线节点的距离, 依次对应编号从小到大的在线节点
+            size_t to = 0;
+            for (size_t i = 0; i < len;) {
+                if (buf[i] < '0' || buf[i] > '9') {
+                    ++i;
+                    continue;
+                }
+                int value = 0;
+                while (i < len && buf[i] >= '0' && buf[i] <= '9') value = value * 10 + (buf[i++] - '0');
+                while (to < MAX_NUMA_NODES && !(online >> to & 1u)) ++to;
+                if (to == MAX_NUMA_NODES) break;
+                distance[from][to++] = value;
+            }
+        }
+#else
+        (void)distance;
+#endif
+    }
+
+#if defined(__linux__)
+    static size_t read_file(const char* path, char* buf, size_t cap) noexcept {
+        const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return 0;
+        const ssize_t len = ::read(fd, buf, cap);
+        ::close(fd);
+        return len > 0 ? static_cast<size_t>(len) : 0;
+    }
+#endif
+};
+
+inline size_t numa_node_count() noexcept {
+    return NumaTopology::instance().node_count();
+}
+
+// @function: 调用线程当前所在 CPU 的 NUMA 节点, 取不到时返回 0
+// @note: 线程随时可能被调度到其他节点, 结果只是一个提示
+inline size_t numa_current_node() noexcept {
+#if defined(__linux__) && defined(SYS_getcpu)
+    unsigned cpu = 0;
+    unsigned node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) return node % MAX_NUMA_NODES;
+#endif
+    return 0;
+}
+
+/*
+ * @function: 让 [ptr, ptr + size) 的物理页优先从 node 分配(MPOL_PREFERRED), 返回是否生效
+ * @param: move 为 true 时把已经提交的页迁移过去(MPOL_MF_MOVE)
+ * @note: 节点内存不足时内核按距离回退到其他节点, 不会因此缺页失败
+ * @note: 单节点系统或 node 不在线时什么都不做; 失败(如映射数超过上限)时保持默认的首次访问策略
+ */
+inline bool os_bind_node(void* ptr, size_t size, size_t node, bool move = false) noexcept {
+#if defined(__linux__) && defined(SYS_mbind)
+    const size_t count = numa_node_count();
+    if (count < 2 || node >= count) return false;
+    constexpr int MPOL_PREFERRED_MODE = 1;
+    constexpr unsigned MPOL_MF_MOVE_FLAG = 1u << 1;
+    const unsigned long mask = 1UL << node;
+    return syscall(SYS_mbind, ptr, size, MPOL_PREFERRED_MODE, &mask,
+                   MAX_NUMA_NODES + 1, move ? MPOL_MF_MOVE_FLAG : 0u) == 0;
+#else
+    (void)ptr;
+    (void)size;
+    (void)node;
+    (void)move;
+    return false;
+#endif
+}
+
+}
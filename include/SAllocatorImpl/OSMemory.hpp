@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace Stellatus {
+
+// note: 新映射的匿名内存本身就是全零的, 物理页在首次访问时才由缺页异常提交
+enum class CommitPolicy {
+    Lazy,     // comment: 只建立映射, 物理页按需提交(默认)
+    Prefault, // comment: 建立映射时预先提交物理页(MAP_POPULATE / 逐页触碰)
+    Zero,     // comment: 显式写零, 提交全部物理页
+};
+
+inline void os_prefault(void* ptr, size_t size) {
+#if defined(_WIN32)
+    SYSTEM_INFO sys_info;
+    GetSystemInfo(&sys_info);
+    const size_t page_size = sys_info.dwPageSize;
+#else
+    const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+    volatile char* bytes = static_cast<volatile char*>(ptr);
+    for (size_t offset = 0; offset < size; offset += page_size) {
+        bytes[offset] = 0;
+    }
+}
+
+// @function: 按 policy 提交一段已经映射的内存
+inline void os_commit(void* ptr, size_t size, CommitPolicy policy) {
+    switch (policy) {
+    case CommitPolicy::Lazy:
+        break;
+    case CommitPolicy::Prefault:
+        os_prefault(ptr, size);
+        break;
+    case CommitPolicy::Zero:
+        std::memset(ptr, 0, size);
+        break;
+    }
+}
+
+inline void* os_alloc(size_t size, CommitPolicy policy = CommitPolicy::Lazy) {
+#if defined(_WIN32)
+    void* ptr = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (!ptr) return nullptr;
+#else
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    #ifdef MAP_POPULATE
+    // note: 由内核在映射时一次性提交, 不必逐页触碰
+    if (policy == CommitPolicy::Prefault) {
+        flags |= MAP_POPULATE;
+        policy = CommitPolicy::Lazy;
+    }
+    #endif
+    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (ptr == MAP_FAILED) return nullptr;
+#endif
+    os_commit(ptr, size, policy);
+    return ptr;
+}
+
+// @function: 提示内核用透明大页(THP)支撑这段映射, 返回是否生效
+// @note: 映射内部按 2MB 对齐的部分会在缺页时直接映射为大页, 首尾不足 2MB 的部分仍是普通页
+// @note: 不支持 THP 的系统上什么都不做
+inline bool os_advise_huge(void* ptr, size_t size) {
+#if defined(MADV_HUGEPAGE)
+    return madvise(ptr, size, MADV_HUGEPAGE) == 0;
+#else
+    (void)ptr;
+    (void)size;
+    return false;
+#endif
+}
+
+// @function: 只保留一段虚拟地址, 不可访问也不占用提交额度, 失败返回 nullptr
+inline void* os_reserve(size_t size) {
+#if defined(_WIN32)
+    return VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS);
+#else
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    #ifdef MAP_NORESERVE
+    flags |= MAP_NORESERVE;
+    #endif
+    void* ptr = mmap(nullptr, size, PROT_NONE, flags, -1, 0);
+    return ptr == MAP_FAILED ? nullptr : ptr;
+#endif
+}
+
+// @function: 把 os_reserve 保留的一段地址变为可读写, 物理页仍在首次访问时才提交
+inline bool os_commit_reserved(void* ptr, size_t size) {
+#if defined(_WIN32)
+    return VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+#else
+    return mprotect(ptr, size, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+/*
+ * @function: 把一段仍然保留映射的内存的物理页还给系统
+ * @param: lazy 为 true 时用 MADV_FREE, 内核在内存紧张时才回收, 再次写入前不产生缺页
+ * @note: 默认 MADV_DONTNEED, RSS 立即下降, 之后读到的是零页
+ * @note: 两种方式下原内容都不再可靠, 调用方必须重新初始化
+ */
+inline void os_purge(void* ptr, size_t size, bool lazy = false) {
+#if defined(_WIN32)
+    (void)lazy;
+    VirtualAlloc(ptr, size, MEM_RESET, PAGE_READWRITE);
+#else
+    #ifdef MADV_FREE
+    if (lazy && madvise(ptr, size, MADV_FREE) == 0) return;
+    #else
+    (void)lazy;
+    #endif
+    madvise(ptr, size, MADV_DONTNEED);
+#endif
+}
+
+/*
+ * @function: 调整一段 os_alloc 映射的大小, 内容保留, 允许移动到新的地址
+ * @note: 只移动页表, 不复制数据; 不支持 mremap 的平台或失败时返回 nullptr, 原映射保持不变
+ */
+inline void* os_remap(void* ptr, size_t old_size, size_t new_size) {
+#if defined(__linux__)
+    void* moved = mremap(ptr, old_size, new_size, MREMAP_MAYMOVE);
+    return moved == MAP_FAILED ? nullptr : moved;
+#else
+    (void)ptr;
+    (void)old_size;
+    (void)new_size;
+    return nullptr;
+#endif
+}
+
+inline void os_free(void* ptr, size_t size) {
+#if defined(_WIN32)
+    VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+    munmap(ptr, size);
+#endif
+}
+
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <new>
+
+#include "OSMemory.hpp"
+
+namespace Stellatus {
+
+/*
+ * @function: 以地址为 key 的两层基数树, 记录每个 4KB 页所属的元数据
+ * @note: 48 位虚拟地址 => 36 位页号, 高 18 位索引 root, 低 18 位索引 leaf
+ * @note: root 与 leaf 都是匿名映射, 只有真正写过的页才会提交物理内存
+ * @note: 查询无锁; 写入只发生在 slab 创建时, 由 mtx 串行化
+ */
+template <typename T>
+class PageMap {
+public:
+    static constexpr size_t PAGE_SHIFT = 12;
+    static constexpr size_t PAGE_BYTES = size_t{1} << PAGE_SHIFT;
+    static constexpr size_t ADDR_BITS = 48;
+    static constexpr size_t LEAF_BITS = 18;
+    static constexpr size_t ROOT_BITS = ADDR_BITS - PAGE_SHIFT - LEAF_BITS;
+    static constexpr size_t LEAF_LENGTH = size_t{1} << LEAF_BITS;
+    static constexpr size_t ROOT_LENGTH = size_t{1} << ROOT_BITS;
+
+    // @function: 返回 ptr 所在页登记的元数据, 未登记则返回 nullptr
+    T* lookup(const void* ptr) const noexcept {
+        const uintptr_t key = reinterpret_cast<uintptr_t>(ptr) >> PAGE_SHIFT;
+        Leaf** root_ = root.load(std::memory_order_acquire);
+        if (!root_ || (key >> LEAF_BITS) >= ROOT_LENGTH) return nullptr;
+        const Leaf* leaf = std::atomic_ref<Leaf*>(root_[key >> LEAF_BITS])
+                               .load(std::memory_order_acquire);
+        if (!leaf) return nullptr;
+        // note: 同一页可能被 munmap 后再次映射给新的 slab, 表项按原子方式读写
+        return std::atomic_ref<T*>(const_cast<T*&>(leaf->values[key & (LEAF_LENGTH - 1)]))
+                   .load(std::memory_order_acquire);
+    }
+
+    // @function: 把 [ptr, ptr + size) 覆盖的每一页都登记为 value
+    void set(const void* ptr, size_t size, T* value) {
+        std::scoped_lock lock(mtx);
+        const uintptr_t first = reinterpret_cast<uintptr_t>(ptr) >> PAGE_SHIFT;
+        const uintptr_t last = (reinterpret_cast<uintptr_t>(ptr) + size - 1) >> PAGE_SHIFT;
+        for (uintptr_t key = first; key <= last; ++key) {
+            Leaf* leaf = ensure_leaf(key >> LEAF_BITS);
+            std::atomic_ref<T*>(leaf->values[key & (LEAF_LENGTH - 1)])
+                .store(value, std::memory_order_release);
+        }
+    }
+
+    // @function: 清除 [ptr, ptr + size) 的登记
+    void clear(const void* ptr, size_t size) {
+        set(ptr, size, nullptr);
+    }
+
+    // @function: fork 前持有 mtx, 之后在父子进程中各自释放, 见 prepare_fork
+    void fork_lock() { mtx.lock(); }
+    void fork_unlock() { mtx.unlock(); }
+
+private:
+    struct Leaf {
+        T* values[LEAF_LENGTH];
+    };
+
+    std::atomic<Leaf**> root{nullptr};
+    std::mutex mtx;
+
+    // note: 调用方持有 mtx
+    Leaf* ensure_leaf(size_t index) {
+        Leaf** root_ = root.load(std::memory_order_relaxed);
+        if (!root_) {
+            root_ = static_cast<Leaf**>(os_alloc(ROOT_LENGTH * sizeof(Leaf*)));
+            if (!root_) throw std::bad_alloc{};
+            root.store(root_, std::memory_order_release);
+        }
+        Leaf* leaf = root_[index];
+        if (!leaf) {
+            leaf = static_cast<Leaf*>(os_alloc(sizeof(Leaf)));
+            if (!leaf) throw std::bad_alloc{};
+            std::atomic_ref<Leaf*>(root_[index]).store(leaf, std::memory_order_release);
+        }
+        return leaf;
+    }
+};
+
+}
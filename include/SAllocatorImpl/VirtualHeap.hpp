@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+
+#include "OSMemory.hpp"
+
+namespace Stellatus {
+
+/*
+ * @function: 第一次使用时保留一整段连续的虚拟地址(不可访问), 之后按需把前缀逐步变为可读写
+ * @note: 切分只是移动 top 指针; 每 COMMIT_STEP 字节才需要一次 mprotect / VirtualAlloc(MEM_COMMIT)
+ * @note: 保留区按 GRANULE 划分, 每个 granule 在 metas 中有一个元数据槽位, 查询只需一次减法和移位
+ * @note: 保留失败(如 ulimit -v 限制)时逐次减半重试, 全部失败则 allocate 返回 nullptr, 由调用方回退到 os_alloc
+ */
+template <typename Meta>
+class VirtualHeap {
+public:
+    static constexpr size_t GRANULE_SHIFT = 16;
+    static constexpr size_t GRANULE = size_t{1} << GRANULE_SHIFT; // comment: 64KB, 切分与元数据登记的粒度
+    static constexpr size_t COMMIT_STEP = size_t{2} << 20;         // comment: 每次提交 2MB
+    static constexpr size_t MAX_RESERVE = size_t{64} << 30;        // comment: 首选保留 64GB
+    static constexpr size_t MIN_RESERVE = size_t{256} << 20;
+
+    // @function: ptr 所在 granule 登记的元数据, 不在保留区内或未登记返回 nullptr
+    Meta* lookup(const void* ptr) const noexcept {
+        // note: 先 acquire 读 reserved, 读到非零时 base 一定已经可见
+        const size_t limit = reserved.load(std::memory_order_acquire);
+        const uintptr_t offset = reinterpret_cast<uintptr_t>(ptr) - base.load(std::memory_order_relaxed);
+        // note: ptr 低于 base 时 offset 回绕为极大值, 一次比较同时排除两侧
+        if (offset >= limit) return nullptr;
+        return std::atomic_ref<Meta*>(metas[offset >> GRANULE_SHIFT]).load(std::memory_order_acquire);
+    }
+
+    bool contains(const void* ptr) const noexcept {
+        const size_t limit = reserved.load(std::memory_order_acquire);
+        const uintptr_t offset = reinterpret_cast<uintptr_t>(ptr) - base.load(std::memory_order_relaxed);
+        return offset < limit;
+    }
+
+    // @function: 切出 size 字节(向上取整到 GRANULE), 按 GRANULE 对齐; 保留区耗尽返回 nullptr
+    void* allocate(size_t size) {
+        size = (size + GRANULE - 1) & ~(GRANULE - 1);
+        std::scoped_lock lock(mtx);
+        if (!reserved.load(std::memory_order_relaxed) && !reserve_failed) reserve();
+
+        const size_t limit = reserved.load(std::memory_order_relaxed);
+        if (size > limit - top) return nullptr;
+        const size_t end = top + size;
+        if (end > committed) {
+            size_t want = (end + COMMIT_STEP - 1) & ~(COMMIT_STEP - 1);
+            if (want > limit) want = limit;
+            char* from = reinterpret_cast<char*>(base.load(std::memory_order_relaxed)) + committed;
+            if (!os_commit_reserved(from, want - committed)) return nullptr;
+            committed = want;
+        }
+        void* ptr = reinterpret_cast<char*>(base.load(std::memory_order_relaxed)) + top;
+        top = end;
+        return ptr;
+    }
+
+    // @function: 把 [ptr, ptr + size) 覆盖的每个 granule 都登记为 meta, ptr 必须来自 allocate
+    void set(const void* ptr, size_t size, Meta* meta) noexcept {
+        const uintptr_t offset = reinterpret_cast<uintptr_t>(ptr) - base.load(std::memory_order_relaxed);
+        for (size_t i = offset >> GRANULE_SHIFT; i <= (offset + size - 1) >> GRANULE_SHIFT; ++i) {
+            std::atomic_ref<Meta*>(metas[i]).store(meta, std::memory_order_release);
+        }
+    }
+
+    // @function: 已经变为可读写的字节数, 仅用于统计
+    size_t committed_bytes() {
+        std::scoped_lock lock(mtx);
+        return committed;
+    }
+
+    // @function: fork 前持有 mtx, 之后在父子进程中各自释放, 见 prepare_fork
+    void fork_lock() { mtx.lock(); }
+    void fork_unlock() { mtx.unlock(); }
+
+private:
+    std::mutex mtx;
+    std::atomic<uintptr_t> base{0};
+    std::atomic<size_t> reserved{0};
+    Meta** metas = nullptr;  // comment: 每个 granule 一个槽位, 匿名映射, 写过的页才占物理内存
+    size_t top = 0;          // comment: 已切出部分的末尾(相对 base)
+    size_t committed = 0;    // comment: 可读写部分的末尾(相对 base)
+    bool reserve_failed = false;
+
+    // note: 调用方持有 mtx
+    void reserve() {
+        for (size_t size = MAX_RESERVE; size >= MIN_RESERVE; size >>= 1) {
+            void* ptr = os_reserve(size);
+            if (!ptr) continue;
+            const size_t meta_bytes = (size >> GRANULE_SHIFT) * sizeof(Meta*);
+            metas = static_cast<Meta**>(os_alloc(meta_bytes));
+            if (!metas) {
+                os_free(ptr, size);
+                break;
+            }
+            base.store(reinterpret_cast<uintptr_t>(ptr), std::memory_order_relaxed);
+            reserved.store(size, std::memory_order_release);
+            return;
+        }
+        reserve_failed = true;
+    }
+};
+
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include <cstddef>
 #include <type_traits>
 #include <utility>
 /*
@@ -7,9 +8,10 @@
     *    i 是 循环变量
     * });
     * 其会在编译期将该 static_for 展开, 形成 End - Beg 行 [](){}
+    * 只要 lambda 本身满足 constexpr 的要求, static_for 也可以在常量表达式中使用
     */
 template <size_t Beg, size_t End, class Lambda>
-void static_for(Lambda lambda) {
+constexpr void static_for(Lambda lambda) {
     if constexpr (Beg < End) {
         std::integral_constant<size_t, Beg> i;
         struct Breaker {
@@ -32,13 +34,13 @@ void static_for(Lambda lambda) {
 }
 
 template <size_t ...Is, class Lambda>
-void _static_for_impl(Lambda lambda, std::index_sequence<Is...>) {
+constexpr void _static_for_impl(Lambda lambda, std::index_sequence<Is...>) {
     (lambda(std::integral_constant<size_t, Is>{}), ...);
     /* std::make_index_sequence<4>; */
     /* std::index_sequence<0, 1, 2, 3>; */
 }
 
 template <size_t N, class Lambda>
-void static_for(Lambda lambda) {
+constexpr void static_for(Lambda lambda) {
     _static_for_impl(lambda, std::make_index_sequence<N>{});
 }
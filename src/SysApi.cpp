@@ -1,7 +1,16 @@
 #include "../include/JAllocatorImpl/SysApi.h"
+#include "../include/SAllocatorImpl/Numa.hpp"
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <mutex>
 #include <new>
-#include <winbase.h>
+#ifdef _WIN32
+    #include <winbase.h>
+#endif
 
 namespace OSAllocator {
     static size_t error = -1;
@@ -19,7 +28,278 @@ namespace OSAllocator {
         return page_size;
     }
 
-    void * OS_Alloc(size_t size, size_t alignment){
+    namespace {
+        // note: 没有预留 HugeTLB 大页时第一次尝试就会失败, 之后不再反复发起注定失败的系统调用
+        std::atomic<bool> hugetlb_usable{true};
+
+        size_t RoundUp(size_t value, size_t align){
+            return (value + align - 1) & ~(align - 1);
+        }
+
+        int64_t NowMs(){
+            return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()
+            ).count();
+        }
+
+        // @function: 把映射绑定到 node 节点, move 为 true 时(复用的映射)已经驻留的页一并迁移
+        void BindNode(void *ptr, size_t size, size_t node, bool move){
+            if (node == AnyNode) return;
+            if (node == CurrentNode) node = Stellatus::numa_current_node();
+            Stellatus::os_bind_node(ptr, size, node, move);
+        }
+
+        void UnmapRaw(void *base, size_t size){
+            #ifdef _WIN32
+                (void)size;
+                VirtualFree(base, 0, MEM_RELEASE);
+            #else
+                munmap(base, size);
+            #endif
+        }
+
+        /*
+         * @function: 映射 size 字节(页的整数倍), 起始地址按 alignment 对齐, 失败返回 nullptr
+         * @note: 对齐不超过映射粒度时直接映射; 否则多保留 alignment - page 字节, 解除首尾未对齐的部分
+         * @note: Windows 不能部分释放, 先保留一段更大的地址找到对齐位置, 释放后在该位置重新分配,
+         * @note: 释放与重新分配之间地址可能被其他线程占用, 因此重试几次
+         * @param: reserve_only 为 true 时只保留地址(PROT_NONE + MAP_NORESERVE / MEM_RESERVE), 见 OS_Reserve
+         */
+        void* MapAligned(size_t size, size_t alignment, bool reserve_only = false){
+            #ifdef _WIN32
+                const DWORD type = reserve_only ? MEM_RESERVE : MEM_COMMIT | MEM_RESERVE;
+                const DWORD protect = reserve_only ? PAGE_NOACCESS : PAGE_READWRITE;
+                SYSTEM_INFO sys_info;
+                GetSystemInfo(&sys_info);
+                if (alignment <= sys_info.dwAllocationGranularity) {
+                    return VirtualAlloc(nullptr, size, type, protect);
+                }
+                for (int attempt = 0; attempt < 4; ++attempt) {
+                    void *probe = VirtualAlloc(nullptr, size + alignment, MEM_RESERVE, PAGE_NOACCESS);
+                    if (!probe) return nullptr;
+                    VirtualFree(probe, 0, MEM_RELEASE);
+                    void *want = reinterpret_cast<void*>(RoundUp(reinterpret_cast<uintptr_t>(probe), alignment));
+                    void *ptr = VirtualAlloc(want, size, type, protect);
+                    if (ptr) return ptr;
+                }
+                return nullptr;
+            #else
+                const size_t page_size = GetPageSize();
+                const size_t extra = alignment > page_size ? alignment - page_size : 0;
+                int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+                #ifdef MAP_NORESERVE
+                if (reserve_only) flags |= MAP_NORESERVE;
+                #endif
+                void *raw = mmap(
+                    nullptr, size + extra, reserve_only ? PROT_NONE : PROT_READ | PROT_WRITE,
+                    flags, -1, 0
+                );
+                if (raw == MAP_FAILED) return nullptr;
+                if (!extra) return raw;
+                const uintptr_t raw_addr = reinterpret_cast<uintptr_t>(raw);
+                const uintptr_t aligned_addr = RoundUp(raw_addr, alignment);
+                const size_t head = aligned_addr - raw_addr;
+                const size_t tail = extra - head;
+                if (head) munmap(raw, head);
+                if (tail) munmap(reinterpret_cast<void*>(aligned_addr + size), tail);
+                return reinterpret_cast<void*>(aligned_addr);
+            #endif
+        }
+
+        /*
+         * @function: 最近释放的大块映射的缓存, 按映射大小分组, 避免反复 mmap / munmap 以及之后的缺页
+         * @note: 分组按大小的对数划分, 每个 2 的幂区间再等分 4 组, 同组映射大小相差不超过 25%
+         * @note: 复用时先找请求所在的组, 再找大一级的组; 大小不一致时用 mremap 原地收缩, 扩张时允许移动
+         * @note: 按大页对齐的映射只截掉尾部, 不扩张, 以免破坏对齐; Windows 下只复用不小于请求的映射, 不调整大小
+         * @note: 缓存的总字节数不超过 limit, 超出时从最大的组开始解除映射
+         * @note: 节点直接写在映射的起始处, 缓存本身不额外申请内存
+         */
+        class MappingCache {
+        public:
+            /*
+             * @function: 取出一段至少按 alignment 对齐, 大小为 want 的缓存映射, 没有合适的映射时返回 nullptr
+             * @param: got 写入映射的实际大小, 只有 Windows 下可能大于 want
+             * @param: huge 映射按大页对齐, 只能截尾
+             * @param: kind 为空时调用方无法记录页类型(OS_Alloc / OS_Free 一律按 Normal 处理), 只复用 Normal 映射
+             */
+            void* Take(size_t want, size_t alignment, bool huge, size_t& got, PageKind* kind){
+                Node* node = nullptr;
+                {
+                    std::scoped_lock lock(mtx);
+                    if (!retained) return nullptr;
+                    const size_t first = GroupOf(want);
+                    for (size_t g = first; g < first + 2 && g < group_num && !node; ++g) {
+                        for (Node** link = &groups[g]; *link; link = &(*link)->next) {
+                            Node* n = *link;
+                            if (reinterpret_cast<uintptr_t>(n) & (alignment - 1)) continue;
+                            // note: 否则大页映射会以 Normal 的身份被 OS_Free 放回缓存, 页类型在复用中丢失
+                            if (!kind && n->kind != PageKind::Normal) continue;
+                            // note: HugeTLB 映射只能按大页截断
+                            if (n->kind == PageKind::HugeTLB && (want & (GetHugePageSize() - 1))) continue;
+                            if (n->size < want && !CanGrow(huge || n->kind == PageKind::HugeTLB)) continue;
+                            *link = n->next;
+                            retained -= n->size;
+                            node = n;
+                            break;
+                        }
+                    }
+                }
+                if (!node) return nullptr;
+
+                void *base = node;
+                size_t size = node->size;
+                const PageKind node_kind = node->kind;
+                #if defined(__linux__)
+                if (size != want && !huge && node_kind != PageKind::HugeTLB) {
+                    void *moved = mremap(base, size, want, MREMAP_MAYMOVE);
+                    if (moved == MAP_FAILED) {
+                        munmap(base, size);
+                        return nullptr;
+                    }
+                    base = moved;
+                    size = want;
+                }
+                #endif
+                #ifndef _WIN32
+                if (size > want) {
+                    munmap(static_cast<char*>(base) + want, size - want);
+                    size = want;
+                }
+                #endif
+                got = size;
+                if (kind) *kind = node_kind;
+                return base;
+            }
+
+            // @function: 缓存一段映射, 超出容量的部分在锁外解除映射
+            void Put(void *base, size_t size, PageKind kind){
+                if (size > limit.load(std::memory_order_relaxed)) {
+                    UnmapRaw(base, size);
+                    return;
+                }
+                Node* victims = nullptr;
+                {
+                    std::scoped_lock lock(mtx);
+                    Node* node = new (base) Node{nullptr, size, kind, NowMs()};
+                    Node*& head = groups[GroupOf(size)];
+                    node->next = head;
+                    head = node;
+                    retained += size;
+                    victims = Evict(limit.load(std::memory_order_relaxed));
+                }
+                Release(victims);
+            }
+
+            // @function: 解除空闲时长不小于 min_idle_ms 的映射, 返回释放的字节数
+            size_t Trim(int64_t min_idle_ms){
+                const int64_t now = NowMs();
+                Node* victims = nullptr;
+                {
+                    std::scoped_lock lock(mtx);
+                    for (Node*& head : groups) {
+                        for (Node** link = &head; *link;) {
+                            Node* n = *link;
+                            if (now - n->idle_since < min_idle_ms) {
+                                link = &n->next;
+                                continue;
+                            }
+                            *link = n->next;
+                            retained -= n->size;
+                            n->next = victims;
+                            victims = n;
+                        }
+                    }
+                }
+                return Release(victims);
+            }
+
+            void SetLimit(size_t bytes){
+                Node* victims = nullptr;
+                {
+                    std::scoped_lock lock(mtx);
+                    limit.store(bytes, std::memory_order_relaxed);
+                    victims = Evict(bytes);
+                }
+                Release(victims);
+            }
+
+            size_t Retained(){
+                std::scoped_lock lock(mtx);
+                return retained;
+            }
+
+        private:
+            struct Node {
+                Node* next;
+                size_t size;
+                PageKind kind;
+                int64_t idle_since;
+            };
+
+            static constexpr size_t group_num = 4 * 64;
+
+            static size_t GroupOf(size_t size){
+                const size_t shift = static_cast<size_t>(std::bit_width(size)) - 1;
+                return shift * 4 + ((size >> (shift - 2)) & 3);
+            }
+
+            static bool CanGrow(bool huge){
+                #if defined(__linux__)
+                    return !huge;
+                #else
+                    (void)huge;
+                    return false;
+                #endif
+            }
+
+            // note: 调用方持有 mtx, 摘下的节点串成链表返回
+            Node* Evict(size_t cap){
+                Node* victims = nullptr;
+                for (size_t g = group_num; g-- > 0 && retained > cap;) {
+                    while (groups[g] && retained > cap) {
+                        Node* n = groups[g];
+                        groups[g] = n->next;
+                        retained -= n->size;
+                        n->next = victims;
+                        victims = n;
+                    }
+                }
+                return victims;
+            }
+
+            static size_t Release(Node* victims){
+                size_t bytes = 0;
+                while (victims) {
+                    Node* next = victims->next;
+                    bytes += victims->size;
+                    UnmapRaw(victims, victims->size);
+                    victims = next;
+                }
+                return bytes;
+            }
+
+            std::mutex mtx;
+            std::array<Node*, group_num> groups{};
+            size_t retained = 0;
+            std::atomic<size_t> limit{size_t{64} << 20};
+        };
+
+        MappingCache mapping_cache;
+    }
+
+    void SetMappingCacheLimit(size_t bytes){
+        mapping_cache.SetLimit(bytes);
+    }
+
+    size_t GetMappingCacheBytes(){
+        return mapping_cache.Retained();
+    }
+
+    size_t TrimMappingCache(std::chrono::milliseconds min_idle){
+        return mapping_cache.Trim(min_idle.count());
+    }
+
+    void * OS_Alloc(size_t size, size_t alignment, size_t node){
         // 保证 alignment 合法性的断言
         CHECK_ALIGNMENT(alignment);
         if (size == 0) [[unlikely]] return nullptr;
@@ -38,124 +318,161 @@ namespace OSAllocator {
             );
         #endif
         }
-        // 正常页面分配:
-        // size_t header_size = sizeof(AllocHeader);
-        size_t header_size = (sizeof(AllocHeader) + alignment - 1) & ~(alignment - 1);
-        size_t total_size = size + alignment + header_size;
-        void *base_ptr = nullptr;
-        bool is_fail = false;
+        // 正常页面分配: 映射本身就按 alignment 对齐, 元数据只有大小, 由 OS_Free 的 size 给出
+        const size_t map_size = RoundUp(size, page_size);
+        const size_t map_align = std::max(alignment, page_size);
+        size_t cached_size = 0;
+        void *ptr = mapping_cache.Take(map_size, map_align, map_align > page_size, cached_size, nullptr);
+        const bool reused = ptr != nullptr;
+        // note: 缓存中没有合适的映射时才向系统申请
+        if (!ptr) ptr = MapAligned(map_size, map_align);
+        if (!ptr) {
         #ifdef _WIN32
-            base_ptr = VirtualAlloc(
-                nullptr,
-                total_size, 
-                MEM_COMMIT | MEM_RESERVE, 
-                PAGE_READWRITE
-            );
-            is_fail = !base_ptr;
-            // size_t align__ = 16;
+            error = GetLastError();
         #else
-            base_ptr = mmap(
-                nullptr,
-                total_size,
-                PROT_READ | PROT_WRITE,
-                MAP_PRIVATE | MAP_ANONYMOUS,
-                -1, 
-                0
-            );
-            is_fail = (base_ptr == MAP_FAILED);
-            // size_t align__ = GetPageSize();
+            error = errno;
         #endif
-        // 处理对齐
-        if (is_fail){
-            //std::cerr << "正常内存页面分配失败\n";
             throw std::bad_alloc();
         }
-        //std::cerr << "正常内存页面分配成功\n";
-        // 指针对齐
-        // note: 将原始地址 raw_addr 向上对齐到 alignment
-        // note: aliged_addr = math.floor((raw_addr + alignment - 1)/alignment) * alignment
-        // note: 等价于: (raw_addr + alignment - 1) & ~(alignment - 1)
-        // note: Eg: raw_addr = 1000, alignment = 64
-        // note: 1000 + 63 = 1063, 二进制为 100001100111
-        // note: alignment - 1 = 63 = 000000111111
-        // note: ~63 = 0xFFFFFFC0
-        // note: 所以 1063 & 0xFFFFFFC0 = 1024，即对齐到下一个 64 倍数
-        uintptr_t raw_addr = reinterpret_cast<uintptr_t>(base_ptr);
-        uintptr_t aligned_addr = (raw_addr + alignment - 1) & ~(alignment - 1);
-        void* aligned_ptr = reinterpret_cast<void*>(aligned_addr);
-
-        uintptr_t header_addr = aligned_addr - sizeof(AllocHeader);
-        if (header_addr < raw_addr) {
-            // 如果 header 会低于 base_ptr，调整对齐方式
-            aligned_addr = (raw_addr + alignment + sizeof(AllocHeader) - 1) & ~(alignment - 1);
-            aligned_ptr = reinterpret_cast<void*>(aligned_addr);
-            header_addr = aligned_addr - sizeof(AllocHeader);
-        }
-        // 记录头部信息
-        auto* header = reinterpret_cast<AllocHeader*>(aligned_addr - header_size);
-        header->base_ptr = base_ptr;
-        header->total_size = total_size;
-  
-        return aligned_ptr;
+        BindNode(ptr, reused ? cached_size : map_size, node, reused);
+        return ptr;
     }
 
 
-    void* OS_AllocBigPage(size_t size, size_t alignment){
-        
-        // 大页分配阈值为 2MB
-        constexpr size_t HUGE_PAGE_THRESHOLD = 2 * 1024 * 1024;
-        if (size < HUGE_PAGE_THRESHOLD) [[unlikely]] {
-            OS_Alloc(size, alignment);
+    size_t GetHugePageSize(){
+        #ifdef _WIN32
+            static const size_t huge_page_size = [] {
+                const size_t large = GetLargePageMinimum();
+                return large ? large : size_t{2 * 1024 * 1024};
+            }();
+            return huge_page_size;
+        #else
+            return 2 * 1024 * 1024;
+        #endif
+    }
+
+    /*
+     * @function: 按 HugeTLB -> 透明大页(THP) -> 普通页 的顺序逐级尝试
+     * @note: 1. HugeTLB: 需要预留大页(Linux: /proc/sys/vm/nr_hugepages, Windows: SeLockMemoryPrivilege)
+     * @note: 2. 多映射一个对齐粒度, 裁掉首尾得到 2MB 对齐的映射, 再 madvise(MADV_HUGEPAGE)
+     * @note:    THP 未开启时 madvise 失败, 这段映射就是普通页, 用法完全相同
+     * @note: 不足一个大页的请求直接走 OS_Alloc, 释放时 OS_FreeBigPage 按 size 区分
+     */
+    void* OS_AllocBigPage(size_t size, size_t alignment, PageKind* kind, size_t node){
+        assert(alignment > 0 && (alignment & (alignment - 1)) == 0
+            && "Alignment must be a power of 2 and greater than 0");
+        const size_t huge_page_size = GetHugePageSize();
+        if (size < huge_page_size) {
+            if (kind) *kind = PageKind::Normal;
+            return OS_Alloc(size, alignment, node);
+        }
+        const size_t align = std::max(alignment, huge_page_size);
+        const size_t map_size = RoundUp(size, huge_page_size);
+        size_t cached_size = 0;
+        if (void *ptr = mapping_cache.Take(map_size, align, true, cached_size, kind)) {
+            BindNode(ptr, cached_size, node, true);
+            return ptr;
         }
-        // 大页面分配(开启大页分配往往需要系统权限)
-        // Linux: 通常需要 root 或 /proc/sys/vm/nr_hugepages 设置
-        // Windows: 需要权限 SeLockMemoryPrivilege
+
         #ifdef _WIN32
-            void *ptr = VirtualAlloc(
-                nullptr,  // 指定地址或 NUL
-                size,     // 要分配的内存大小(以字节为单位
-                MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES, // 分配类型
-            /*  flAllocationType
-                note: MEM_RESERVE: 保留地址空间, 但不分配物理内存(虚拟映射)
-                note: MEM_COMMIT:  实际分配物理内存并初始化为 0
-                note: MEM_RESET:   表示该区域即将被重新初始化
-                note: MEM_LARGE_PAGES: 使用大页(通常为 2MB 或更大),
-            */
-                PAGE_READWRITE // 保护类型
-            /* flProtect 
-                note: PAGE_READONLY : 只读
-                note: PAGE_READWRITE: 可读写
-                note: PAGE_EXECUTE_READ: 可读执行
-                note: PAGE_EXECUTE_READWRITE: 可读写执行
-                note: PAGE_NOACCESS: 无权限, 用于异常触发
-            */
-            );
-            if (ptr) return ptr;
+            if (align == huge_page_size && hugetlb_usable.load(std::memory_order_relaxed)) {
+                void *ptr = VirtualAlloc(
+                    nullptr, map_size,
+                    MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES, PAGE_READWRITE
+                );
+                if (ptr) {
+                    if (kind) *kind = PageKind::HugeTLB;
+                    return ptr;
+                }
+                error = GetLastError();
+                hugetlb_usable.store(false, std::memory_order_relaxed);
+            }
+            if (void *ptr = MapAligned(map_size, align)) {
+                if (kind) *kind = PageKind::Normal;
+                return ptr;
+            }
             error = GetLastError();
-            std::cerr << "VirtualAlloc failed with error: " << error << "\n";
-        #elif defined(__linux__)
-            void *ptr = mmap(
-                nullptr, // 通常为 NULL, 系统自动选择
-                size,    // 要映射的大小(页对齐)
-                PROT_READ | PROT_WRITE, // 内存保护属性
-                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, // 控制映射行为
-            /*
-                note: MAP_PRIVATE: 写时复制(不会影响文件)
-                note: MAP_SHARED: 修改反映到文件
-                note: MAP_ANONYMOUS: 匿名映射(fd 必须是 -1)
-                note: MAP_HUGETLB: 使用大页(HugeTLB), 
-                note: MAP_FIXED: 强制映射到指定地址（危险，易引起 SEGFAULT）
-            */
-                -1,      // 映射的文件描述符(匿名映射时设为 -1)
-                0        // 映射文件的起始偏移
-            );
-            if (ptr != MAP_FAILED) return ptr;
+        #else
+            #ifdef MAP_HUGETLB
+            // note: HugeTLB 映射天然按大页对齐, 更大的对齐要求无法保证, 跳过这一级
+            if (align == huge_page_size && hugetlb_usable.load(std::memory_order_relaxed)) {
+                void *ptr = mmap(
+                    nullptr, map_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0
+                );
+                if (ptr != MAP_FAILED) {
+                    BindNode(ptr, map_size, node, false);
+                    if (kind) *kind = PageKind::HugeTLB;
+                    return ptr;
+                }
+                error = errno;
+                hugetlb_usable.store(false, std::memory_order_relaxed);
+            }
+            #endif
+            if (void *ptr = MapAligned(map_size, align)) {
+                BindNode(ptr, map_size, node, false);
+                PageKind got = PageKind::Normal;
+                #ifdef MADV_HUGEPAGE
+                if (madvise(ptr, map_size, MADV_HUGEPAGE) == 0) got = PageKind::Transparent;
+                #endif
+                if (kind) *kind = got;
+                return ptr;
+            }
             error = errno;
-            std::cerr << "mmap failed with error: " << strerror(error) << "\n";
         #endif
         throw std::bad_alloc();
-        return nullptr;
     }
+
+    void OS_FreeBigPage(void *ptr, size_t size, PageKind kind){
+        if (!ptr) return;
+        const size_t huge_page_size = GetHugePageSize();
+        if (size < huge_page_size) {
+            OS_Free(ptr, size);
+            return;
+        }
+        mapping_cache.Put(ptr, RoundUp(size, huge_page_size), kind);
+    }
+
+    void OS_Purge(void *ptr, size_t size){
+        if (!ptr || !size) return;
+        #ifdef _WIN32
+            VirtualAlloc(ptr, size, MEM_RESET, PAGE_READWRITE);
+        #else
+            madvise(ptr, size, MADV_DONTNEED);
+        #endif
+    }
+
+    void* OS_Reserve(size_t size, size_t alignment, size_t node){
+        CHECK_ALIGNMENT(alignment);
+        const size_t page_size = GetPageSize();
+        const size_t map_size = RoundUp(size ? size : 1, page_size);
+        void *ptr = MapAligned(map_size, std::max(alignment, page_size), true);
+        if (!ptr) {
+        #ifdef _WIN32
+            error = GetLastError();
+        #else
+            error = errno;
+        #endif
+            throw std::bad_alloc();
+        }
+        BindNode(ptr, map_size, node, false);
+        return ptr;
+    }
+
+    bool OS_Commit(void *ptr, size_t size){
+        #ifdef _WIN32
+            return VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+        #else
+            // note: vm.overcommit_memory=2 时提交额度在这里才扣除, 不足时 mprotect 失败(ENOMEM)
+            return mprotect(ptr, size, PROT_READ | PROT_WRITE) == 0;
+        #endif
+    }
+
+    void OS_Release(void *ptr, size_t size){
+        if (!ptr) return;
+        UnmapRaw(ptr, RoundUp(size ? size : 1, GetPageSize()));
+    }
+
     void OS_Free(void *ptr, size_t size){
         if (!ptr) return;
 
@@ -170,16 +487,7 @@ namespace OSAllocator {
             return;
         } 
 
-        auto* header = reinterpret_cast<AllocHeader*>(
-            reinterpret_cast<uintptr_t>(ptr) - sizeof(AllocHeader)
-        );
-        void* base_ptr = header->base_ptr;
-        size_t total_size = header->total_size;
-        #ifdef _WIN32
-            VirtualFree(base_ptr, 0, MEM_RELEASE);
-        #else
-            munmap(base_ptr, total_size);
-        #endif
-        
+        // note: ptr 就是映射的起始地址; 映射先放入缓存, 超出缓存容量时才真正解除映射
+        mapping_cache.Put(ptr, RoundUp(size, page_size), PageKind::Normal);
     }
 }
\ No newline at end of file
@@ -1,65 +1,15 @@
-#include "../include/SAllocator.hpp"
-#include <chrono>
 #include <iostream>
 #include <vector>
 #include <cstdlib>
 #include <cstring>
 #include <cassert>
+#include <set>
+#include <thread>
 #include "../include/JAllocatorImpl/SysApi.h"
+#include "../include/JAllocator.hpp"
+#include "../include/SAllocator.hpp"
 
 
-using namespace Stellatus;
-
-constexpr size_t N = 10'000'000;
-constexpr size_t ALLOC_SIZE = 64;
-constexpr size_t LARGE_SIZE = 8ULL * 1024 * 1024 * 1024; // 8GB
-
-template <typename Alloc>
-void test_alloc(const std::string& name) {
-    std::vector<void*> ptrs;
-    ptrs.reserve(N);  // 避免 std::vector 本身频繁扩容干扰测试
-
-    auto t1 = std::chrono::high_resolution_clock::now();
-
-    for (size_t i = 0; i < N; ++i) {
-        void* p = Alloc{}.allocate(ALLOC_SIZE);
-        std::memset(p, static_cast<int>(i), ALLOC_SIZE);  // 写入，防止优化
-        ptrs.push_back(p);
-    }
-
-
-    for (void* p : ptrs) {
-        Alloc{}.deallocate(static_cast<char*>(p), ALLOC_SIZE);
-    }
-
-    auto t2 = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double> d = t2 - t1;
-    std::cout << name << ": " << d.count() << " seconds" << std::endl;
-}
-
-void test_large_alloc(const std::string& name, auto alloc_fn, auto free_fn) {
-    void* ptr = alloc_fn();
-
-    if (!ptr) {
-        std::cerr << "allocation failed for " << name << std::endl;
-        return;
-    }
-
-    auto t1 = std::chrono::high_resolution_clock::now();
-
-    // 强制访问每一页
-    for (size_t offset = 0; offset < LARGE_SIZE; offset += 4096) {
-        static_cast<volatile char*>(ptr)[offset] = 0xCD;
-    }
-
-    auto t2 = std::chrono::high_resolution_clock::now();
-
-    free_fn(ptr);
-
-    std::chrono::duration<double> d = t2 - t1;
-    std::cout << name << " (8GB write): " << d.count() << " seconds" << std::endl;
-}
-
 template <typename Ty, std::size_t Num>
 struct A{
     using value_type = Ty;
@@ -110,7 +60,160 @@ void test_allocation(size_t size, size_t alignment) {
     std::cout << "OK\n";
 }
 
+// 标量参考实现: 按地址从低到高列出 bitmap 中前 n 个空闲 slot
+std::vector<void*> scalar_scan(const Region& region, uint32_t n) {
+    std::vector<void*> slots;
+    for (uint32_t word = 0; word < region_bitmap_words && slots.size() < n; ++word) {
+        for (uint32_t bit = 0; bit < 64 && slots.size() < n; ++bit) {
+            if (region.bitmap[word] >> bit & 1) slots.push_back(region.slot_at(word, bit));
+        }
+    }
+    return slots;
+}
+
+void test_region_batch(uint32_t slot_size) {
+    std::cout << "Region alloc_batch with slot size " << slot_size << " ... ";
+
+    void* mem = OS_Alloc(region_bytes, region_bytes);
+    assert(is_aligned(mem, region_bytes));
+    Region* region = new (mem) Region();
+    region->init(0, slot_size);
+
+    // 整批取空, 结果互不相同, 按 slot 对齐且都落在 Region 内
+    // note: alloc_batch 的调用不能写在 assert 中, NDEBUG 下会被整个去掉
+    std::vector<void*> all(region->slot_num);
+    [[maybe_unused]] const uint32_t all_n = region->alloc_batch(all.data(), region->slot_num);
+    assert(all_n == region->slot_num);
+    assert(region->full());
+#ifndef NDEBUG
+    const std::size_t slot_align = slot_size >= page ? page : 64;
+    std::set<void*> unique(all.begin(), all.end());
+    assert(unique.size() == all.size());
+    for (void* ptr : all) {
+        assert(Region::from_ptr(ptr) == region);
+        assert(is_aligned(ptr, std::min<std::size_t>(slot_align, slot_size & -slot_size)));
+    }
+#endif
+
+    // 只释放 Region 尾部零散的 slot, 前面留下一长段全零的 bitmap 字, AVX2 扫描会整段跳过
+    region->hint = 0;
+    std::vector<void*> freed;
+    for (std::size_t i = all.size() / 2; i < all.size(); i += 7) {
+        region->free(all[i]);
+        freed.push_back(all[i]);
+    }
+    region->hint = 0;
+    const std::vector<void*> expected = scalar_scan(*region, static_cast<uint32_t>(freed.size()));
+    std::vector<void*> got(freed.size());
+    [[maybe_unused]] const uint32_t got_n = region->alloc_batch(got.data(), static_cast<uint32_t>(got.size()));
+    assert(got_n == got.size());
+    assert(got == expected && got == freed);
+    assert(region->full());
+
+    // 释放整批后 slot 重新可用, 再取一次得到同样的 slot
+    for (void* ptr : all) region->free(ptr);
+    assert(region->empty());
+    std::vector<void*> again(region->slot_num);
+    [[maybe_unused]] const uint32_t again_n = region->alloc_batch(again.data(), region->slot_num);
+    assert(again_n == region->slot_num);
+    assert(again == all);
+
+    // reset 一次性归还全部 slot
+    region->reset();
+    assert(region->empty());
+    [[maybe_unused]] void* first = region->alloc();
+    assert(first == all.front());
+
+    OS_Free(mem, region_bytes);
+    std::cout << "OK\n";
+}
+
+struct alignas(64) CacheLine {
+    char data[72];
+};
+
+void test_object_pool() {
+    std::cout << "ObjectPool / PoolAllocator with alignas(64) ... ";
+
+    std::vector<CacheLine*> objs;
+    for (int i = 0; i < 1000; ++i) {
+        CacheLine* obj = ObjectPool<CacheLine>::New();
+        assert(is_aligned(obj, alignof(CacheLine)));
+        std::memset(obj->data, i & 0xFF, sizeof(obj->data));
+        objs.push_back(obj);
+    }
+    assert(std::set<CacheLine*>(objs.begin(), objs.end()).size() == objs.size());
+    for (CacheLine* obj : objs) ObjectPool<CacheLine>::Delete(obj);
+
+    PoolAllocator<CacheLine> alloc;
+    CacheLine* one = alloc.allocate(1);
+    CacheLine* many = alloc.allocate(3);
+    assert(is_aligned(one, alignof(CacheLine)) && is_aligned(many, alignof(CacheLine)));
+    alloc.deallocate(many, 3);
+    alloc.deallocate(one, 1);
+
+    std::cout << "OK\n";
+}
+
+void test_stellatus_batch(size_t size) {
+    std::cout << "Stellatus allocate_batch / free_batch " << size << " bytes ... ";
+
+    constexpr size_t n = 3000;
+    std::vector<void*> ptrs(n);
+    Stellatus::allocate_batch(size, n, ptrs.data());
+    assert(std::set<void*>(ptrs.begin(), ptrs.end()).size() == n);
+    for (void* ptr : ptrs) {
+        assert(ptr && is_aligned(ptr, Stellatus::ALIGNMENT));
+        assert(Stellatus::Arena::usable_size(ptr) >= size);
+        std::memset(ptr, 0xCD, size);
+    }
+    Stellatus::free_batch(ptrs.data(), n);
+
+    std::cout << "OK\n";
+}
+
+// 节点 1 上分配的对象由节点 0 的线程释放, 应进入 node_inboxes[1], 之后由节点 1 的线程取回
+// size 不超过 MAX_SMALL_SIZE 时是 slab 对象, 否则是头部记录了节点的块
+void test_cross_node_free(size_t size) {
+    std::cout << "Stellatus cross-node free into node_inboxes " << size << " bytes ... ";
+
+    void* p = nullptr;
+    void* q = nullptr;
+    std::thread([&] {
+        Stellatus::set_thread_node(1);
+        assert(Stellatus::tls_arena->node_id() == 1);
+        p = Stellatus::tls_arena->allocate(size);
+        q = Stellatus::tls_arena->allocate(size);
+    }).join();
+
+    // 带大小的 deallocate 与 free 走同样的节点判断
+    Stellatus::set_thread_node(0);
+    assert(Stellatus::node_inboxes[1].empty());
+    Stellatus::tls_arena->deallocate(q, size);
+    assert(!Stellatus::node_inboxes[1].empty());
+    Stellatus::Arena::free(*Stellatus::tls_arena, p, size);
+
+    void* r = nullptr;
+    std::thread([&] {
+        Stellatus::set_thread_node(1);
+        r = Stellatus::tls_arena->allocate(size);
+    }).join();
+    assert(Stellatus::node_inboxes[1].empty());
+    assert(r == p || r == q);
+    Stellatus::Arena::free(*Stellatus::tls_arena, r, size);
+
+    std::cout << "OK\n";
+}
+
 int main() {
+    std::cout << "========== Region / ObjectPool Test ==========\n";
+    for (uint32_t slot_size : {16u, 48u, 64u, 4096u}) test_region_batch(slot_size);
+    test_object_pool();
+
+    std::cout << "========== Stellatus Test ==========\n";
+    for (size_t size : {8u, 100u, 4000u, 20000u}) test_stellatus_batch(size);
+    for (size_t size : {48u, 65536u}) test_cross_node_free(size);
+
     std::cout << "========== OS_Alloc / OS_Free Test ==========\n";
 
     